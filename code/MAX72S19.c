@@ -5,172 +5,249 @@
  *  Author: Mich
  */ 
 
-#include "MAX72S19.h"
+#include "display.h"
 #define _BV(bit) (1 << (bit))
-#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
 
+#ifdef MAX72S19_FIXED_PINS
+// A single sbi or cbi, which can't be interrupted halfway, see below
+#define PIN_HIGH(pin) (PORTA |= _BV(pin))
+#define PIN_LOW(pin) (PORTA &= ~_BV(pin))
+#define _pinChipSelect MAX72S19_PIN_CS
+#define _pinDataOut MAX72S19_PIN_DATA
+#define _pinClock MAX72S19_PIN_CLK
+#else
+#define PIN_HIGH(pin) PORTA_SET(_BV(pin))
+#define PIN_LOW(pin) PORTA_CLEAR(_BV(pin))
+#endif
+
+#if defined(MAX72S19_ATOMIC_PORT) && !defined(MAX72S19_FIXED_PINS)
+#include <avr/interrupt.h>
+// Another pin on port A is driven from an interrupt (the telemetry UART), so
+// our read-modify-write of PORTA must not be interrupted halfway, or its
+// change would be undone. Costs a few cycles per edge.
+#define PORTA_SET(mask) do { \
+    uint8_t sreg = SREG; cli(); PORTA |= (mask); SREG = sreg; \
+  } while (0)
+#define PORTA_CLEAR(mask) do { \
+    uint8_t sreg = SREG; cli(); PORTA &= ~(mask); SREG = sreg; \
+  } while (0)
+#else
+#define PORTA_SET(mask) (PORTA |= (mask))
+#define PORTA_CLEAR(mask) (PORTA &= ~(mask))
+#endif
+
+#ifndef MAX72S19_FIXED_PINS
 static uint8_t _pinChipSelect;
 static uint8_t _pinDataOut;
 static uint8_t _pinClock;
+#endif
 
-static uint8_t _mapChar(char inputChar);
 static void _beginTransmission();
 static void _endTransmission();
-static void _setDigitRegister(uint8_t reg, uint8_t data);
-static void _setRegister(uint8_t reg, uint8_t data);
+static void _setRegister(uint8_t chips, uint8_t reg, const uint8_t * data,
+                         uint8_t step);
+static void _setControl(uint8_t reg, uint8_t data);
 static void _shiftOut(uint8_t data);
 
-static uint8_t _digitCache[MAX_DIGITS];
+#define ALL_CHIPS ((1 << MAX72S19_CHIPS) - 1)
 
-void displaySetup(uint8_t pinChipSelect, uint8_t pinDataOut, uint8_t pinClock,
-                  uint8_t decodeMode, uint8_t intensity, uint8_t scanLimit) {
-  _pinChipSelect = pinChipSelect;
-  _pinDataOut = pinDataOut;
-  _pinClock = pinClock;	
+// Intensity as last written, so displayBackendScrub can re-assert it. The
+// chip can't be read back, so this is our only idea of its state.
+static uint8_t _intensity;
 
-  DDRA |= _BV(_pinChipSelect) | _BV(_pinDataOut) | _BV(_pinClock);
-  PORTA &= ~(_BV(_pinDataOut) | _BV(_pinClock));
-  PORTA |= _BV(_pinChipSelect);
+// Scrubber slots: one per digit register on every chip, followed by the
+// control registers, which are written to all chips at once
+#define SCRUB_SLOT_DECODEMODE  (DISPLAY_DIGITS + 0)
+#define SCRUB_SLOT_SCANLIMIT   (DISPLAY_DIGITS + 1)
+#define SCRUB_SLOT_INTENSITY   (DISPLAY_DIGITS + 2)
+#define SCRUB_SLOT_DISPLAYTEST (DISPLAY_DIGITS + 3)
+#define SCRUB_SLOT_SHUTDOWN    (DISPLAY_DIGITS + 4)
+#define SCRUB_SLOTS            (DISPLAY_DIGITS + 5)
 
-  _setRegister(REG_DECODEMODE, decodeMode);
-  displaySetIntensity(intensity);
-  _setRegister(REG_SCANLIMIT, constrain(scanLimit, 0x0, 0xF));
+static uint8_t _scrubSlot;
 
-  for (uint8_t i = 0; i < MAX_DIGITS; i++) _digitCache[i] = 0x00;
-  displayClear();
-  _setRegister(REG_SHUTDOWN, 1);
+#ifndef MAX72S19_FIXED_PINS
+void displaySetPins(uint8_t pinChipSelect, uint8_t pinDataOut,
+                    uint8_t pinClock) {
+  _pinChipSelect = pinChipSelect;
+  _pinDataOut = pinDataOut;
+  _pinClock = pinClock;
 }
+#endif
 
+// No decoding, the frame holds segments (see displayGlyph), in the same order
+// the chip takes them
+void displayBackendSetup(uint8_t intensity) {
+  static const uint8_t blank = 0x00;
 
-void displaySetLED(uint8_t row, uint8_t column, bool on) {
-  uint8_t newRowData = _digitCache[row];
-
-  if (on) {
-    newRowData |= (1 << column);
-  } else {
-    newRowData &= ~(1 << column);
-  }
-
-  _setDigitRegister(REG_DIGIT0 + row, newRowData);
-}
+  DDRA |= _BV(_pinChipSelect) | _BV(_pinDataOut) | _BV(_pinClock);
+  PIN_LOW(_pinDataOut);
+  PIN_LOW(_pinClock);
+  PIN_HIGH(_pinChipSelect);
 
-void displaySetRow(uint8_t row, uint8_t states) {
-  _setDigitRegister(REG_DIGIT0 + row, states);
-}
+  _intensity = intensity;
+  _setControl(REG_DECODEMODE, 0x00);
+  _setControl(REG_INTENSITY, _intensity);
+  _setControl(REG_SCANLIMIT, MAX72S19_SCAN_LIMIT);
 
-void displayClear() {
   for (uint8_t i = 0; i < MAX_DIGITS; i++) {
-    // Not using _setDigitRegister, because for clearing we don't want
-    // to rely on the cache being correct. Instead, we make sure to clear
-    // the display cache here, though.
-    _setRegister(REG_DIGIT0 + i, 0x00);
-    _digitCache[i] = 0x00;
+    _setRegister(ALL_CHIPS, MAX72S19_DIGIT_REG(i), &blank, 0);
   }
-}
 
-void displayWrite(uint8_t reg, uint8_t value) {
-	_setDigitRegister(reg, value);
+  _setControl(REG_SHUTDOWN, 1);
 }
 
-void displayWriteChar(uint8_t digitIndex, char character, bool dotOn) {
-	digitIndex = constrain(digitIndex, 0, 7);
-	uint8_t value = _mapChar(character);
-
-	if (dotOn) {
-		value |= 0b10000000;
-	}
+// Every transmission writes one register on every chip in the chain, so a
+// digit that changed on more than one chip (a score on each table) goes out
+// in one transmission, with a no-op for the chips where it didn't change
+void displayBackendCommit(const uint8_t * frame, DisplayMask digits,
+                          uint8_t intensity, bool intensityChanged) {
+  if (intensityChanged) {
+    _intensity = intensity;
+    _setControl(REG_INTENSITY, _intensity);
+  }
 
-	_setDigitRegister(REG_DIGIT0 + digitIndex, value);
-}
+  for (uint8_t i = 0; i < MAX_DIGITS && digits; i++, digits >>= 1) {
+    uint8_t chips = 0;
 
-void displayWriteNumber(uint8_t digitIndex, uint8_t number) {
-	number = constrain(number, 0, 9);
-	displayWriteChar(digitIndex, '0' + number, false);
-}
+    for (uint8_t chip = 0; chip < MAX72S19_CHIPS; chip++) {
+      if (digits & ((DisplayMask)1 << (chip * MAX_DIGITS))) {
+        chips |= 1 << chip;
+      }
+    }
 
-void displaySetIntensity(uint8_t intensity) {
-	_setRegister(REG_INTENSITY, constrain(intensity, 0x0, 0xF));
+    if (chips) {
+      _setRegister(chips, MAX72S19_DIGIT_REG(i), &frame[i], MAX_DIGITS);
+    }
+  }
 }
 
-// Private methods
+// Rewrites a single register per call, round-robin through the digit
+// registers and then the control registers, using the values we last wrote.
+// Writes are normally only made when the frame changes, so if the chip's
+// registers get corrupted the display would stay wrong until the content
+// changes. Being called every tick makes it heal within SCRUB_SLOTS ticks, at
+// the cost of one transmission per tick, and without the flash of a clear.
+void displayBackendScrub(const uint8_t * frame, uint8_t intensity) {
+  uint8_t slot = _scrubSlot;
+  uint8_t reg;
+  uint8_t data;
+
+  if (++_scrubSlot == SCRUB_SLOTS) _scrubSlot = 0;
+
+  if (slot < DISPLAY_DIGITS) {
+    _setRegister(1 << slot / MAX_DIGITS,
+                 MAX72S19_DIGIT_REG(slot % MAX_DIGITS), frame + slot, 0);
+    return;
+  }
 
-static uint8_t _mapChar(char inputChar) {
-  switch (inputChar) {
-    //  Segments legend:
-    //          _______
-    //        /   A   /
-    //     F /       / B
-    //      /_______/
-    //     /   G   /
-    //  E /       / C
-    //   /_______/ * dp
-    //       D
-    //                dpABCDEFG
-    case '0': return 0b01111110;
-    case '1': return 0b00110000;
-    case '2': return 0b01101101;
-    case '3': return 0b01111001;
-    case '4': return 0b00110011;
-    case '5': return 0b01011011;
-    case '6': return 0b01011111;
-    case '7': return 0b01110000;
-    case '8': return 0b01111111;
-    case '9': return 0b01111011;
-    case 'P': return 0b01100111;
-    case 'i': return 0b00010000;
-    case 'n': return 0b00010101;
-    case 'g': return 0b01111011;
-    case 'o': return 0b00011101;
-    default:  return 0b00000000;
+  switch (slot) {
+    case SCRUB_SLOT_DECODEMODE:  reg = REG_DECODEMODE;  data = 0; break;
+    case SCRUB_SLOT_SCANLIMIT:
+      reg = REG_SCANLIMIT;
+      data = MAX72S19_SCAN_LIMIT;
+      break;
+    case SCRUB_SLOT_INTENSITY:   reg = REG_INTENSITY;   data = _intensity; break;
+    case SCRUB_SLOT_DISPLAYTEST: reg = REG_DISPLAYTEST; data = 0; break;
+    case SCRUB_SLOT_SHUTDOWN:    // Fallthrough intentional
+    default:                     reg = REG_SHUTDOWN;    data = 1; break;
   }
+
+  _setControl(reg, data);
 }
 
+// Private methods
+
+// One pin at a time, so with fixed pins each is a single instruction
 static void _beginTransmission() {
-	PORTA &= ~(_BV(_pinChipSelect) | _BV(_pinClock));
+	PIN_LOW(_pinClock);
+	PIN_LOW(_pinChipSelect);
 }
 
 static void _endTransmission() {
-	PORTA |= _BV(_pinChipSelect);
-	PORTA &= ~_BV(_pinClock);
+	PIN_HIGH(_pinChipSelect);
+	PIN_LOW(_pinClock);
 }
 
-static void _setDigitRegister(uint8_t reg, uint8_t data) {
-  if (reg < REG_DIGIT0 || reg > REG_DIGIT7) return;
+// Writes a register on the chips set in the mask, chip 0 the one wired to the
+// microcontroller. Chip n gets data[n * step]. The other chips in the chain
+// get a no-op, so their registers are left alone.
+static void _setRegister(uint8_t chips, uint8_t reg, const uint8_t * data,
+                         uint8_t step) {
+  _beginTransmission();
+
+  // What's shifted out first ends up in the chip furthest down the chain
+  for (uint8_t i = MAX72S19_CHIPS; i-- > 0;) {
+    if (!(chips & (1 << i))) {
+      _shiftOut(REG_NOOP);
+      _shiftOut(0);
+      continue;
+    }
+
+#ifdef MAX72S19_TRACE
+    displayTraceWrite(i, reg, data[i * step]);
+#endif
+
+    _shiftOut(reg);
+    _shiftOut(data[i * step]);
+  }
 
-  // Don't write if value matches cached value
-  if (data == _digitCache[reg - REG_DIGIT0]) return;
-  _digitCache[reg - REG_DIGIT0] = data;
+  _endTransmission();
+}
 
-  _setRegister(reg, data);
+// Control registers are set the same on every chip
+static void _setControl(uint8_t reg, uint8_t data) {
+  _setRegister(ALL_CHIPS, reg, &data, 0);
 }
 
-static void _setRegister(uint8_t reg, uint8_t data) {
-  _beginTransmission();;
+#ifdef MAX72S19_FIXED_PINS
 
-  switch (reg) {
-    case REG_DIGIT0: reg = REG_DIGIT3; break;
-    case REG_DIGIT1: reg = REG_DIGIT2; break;
-    case REG_DIGIT2: reg = REG_DIGIT1; break;
-    case REG_DIGIT3: reg = REG_DIGIT0; break;
-  }
+// Most significant bit first: a bit test, and sbi/cbi on the data and clock
+// pins. The clock pulse is 2 cycles, well over the chip's 50ns at 16MHz.
+#define SHIFT_BIT(data, bit) do { \
+    if ((data) & _BV(bit)) { \
+      PIN_HIGH(_pinDataOut); \
+    } else { \
+      PIN_LOW(_pinDataOut); \
+    } \
+    PIN_HIGH(_pinClock); \
+    PIN_LOW(_pinClock); \
+  } while (0)
 
-  _shiftOut(reg);
-  _shiftOut(data);
-  _endTransmission();
+static void _shiftOut(uint8_t data) {
+#ifdef MAX72S19_UNROLL
+  SHIFT_BIT(data, 7);
+  SHIFT_BIT(data, 6);
+  SHIFT_BIT(data, 5);
+  SHIFT_BIT(data, 4);
+  SHIFT_BIT(data, 3);
+  SHIFT_BIT(data, 2);
+  SHIFT_BIT(data, 1);
+  SHIFT_BIT(data, 0);
+#else
+  for (uint8_t i = 0; i < 8; i++) {
+    SHIFT_BIT(data, 7);
+    data <<= 1;
+  }
+#endif
 }
 
+#else
+
 static void _shiftOut(uint8_t data) {
 	for (uint8_t i = 0; i < 8; i++) {
 		uint8_t val = !!(data & _BV(7 - i));
 		
 		if (val) {
-			PORTA |= _BV(_pinDataOut);
+			PORTA_SET(_BV(_pinDataOut));
 		} else {
-			PORTA &= ~_BV(_pinDataOut);
+			PORTA_CLEAR(_BV(_pinDataOut));
 		}
 		
-		PORTA |= _BV(_pinClock);
+		PORTA_SET(_BV(_pinClock));
 		// TODO If this appears to be too fast, add a delay here
-		PORTA &= ~_BV(_pinClock);
+		PORTA_CLEAR(_BV(_pinClock));
 	}	
 }
+
+#endif // MAX72S19_FIXED_PINS
@@ -5,7 +5,7 @@
  *  Author: Mich
  */ 
 
-#include <stdbool.h>
+#include <stdint.h>
 #include <avr/io.h>
 
 #ifndef MAX72S19_H_
@@ -28,15 +28,50 @@
 
 #define MAX_DIGITS      8
 
-void displaySetup(uint8_t pinChipSelect, uint8_t pinDataOut, uint8_t pinClock,
-                  uint8_t decodeMode, uint8_t intensity, uint8_t scanLimit);
-void displaySetLED(uint8_t row, uint8_t column, bool on);
-void displaySetRow(uint8_t row, uint8_t states);
-void displayClear();
-void displayWrite(uint8_t reg, uint8_t value);
-void displayWriteChar(uint8_t digitIndex, char character, bool dotOn);
-void displayWriteNumber(uint8_t digitIndex, uint8_t number);
-void displaySetIntensity(uint8_t intensity);
+// Number of chips daisy chained, DOUT to DIN. Digits are numbered across all
+// of them, digit 0-7 on the chip wired to the microcontroller, 8-15 on the next
+// and so on. Control registers are set the same on every chip.
+#ifndef MAX72S19_CHIPS
+#define MAX72S19_CHIPS  1
+#endif
+
+// The chip select, data and clock pins, all on port A, can be fixed at compile
+// time by defining all three, "make FIXED_PINS=1". Every pin change is then a
+// single sbi or cbi rather than a shift and a read-modify-write of PORTA, and
+// there's no displaySetPins. Defining MAX72S19_UNROLL as well unrolls the
+// loop that shifts out a byte, for some more speed and flash.
+#if defined(MAX72S19_PIN_CS) && defined(MAX72S19_PIN_DATA) \
+    && defined(MAX72S19_PIN_CLK)
+#define MAX72S19_FIXED_PINS
+#endif
+
+// Digits 0-6 are scanned, as wired on the board
+#define MAX72S19_SCAN_LIMIT 6
+
+// The shape of the display, see display.h
+#define DISPLAY_MODULE_DIGITS MAX_DIGITS
+#define DISPLAY_MODULES       MAX72S19_CHIPS
+
+// The board has the first four digits of every chip wired in reverse. Digit
+// register of a digit on its chip, and digit on its chip of a register.
+#define MAX72S19_DIGIT_REG(digit) \
+  ((digit) < 4 ? REG_DIGIT3 - (digit) : REG_DIGIT0 + (digit))
+#define MAX72S19_REG_DIGIT(reg) \
+  ((reg) <= REG_DIGIT3 ? REG_DIGIT3 - (reg) : (reg) - REG_DIGIT0)
+
+// This is the display backend for display.h. Without fixed pins, set them
+// before displaySetup.
+#ifndef MAX72S19_FIXED_PINS
+void displaySetPins(uint8_t pinChipSelect, uint8_t pinDataOut,
+                    uint8_t pinClock);
+#endif
+
+#ifdef MAX72S19_TRACE
+// Called for every register write that goes out on the bus, with the chip it
+// is for and the register as sent to it. Implemented by host side tools, see
+// host/bus-analyzer.c
+void displayTraceWrite(uint8_t chip, uint8_t reg, uint8_t data);
+#endif
 
 
 #endif /* MAX72S19_H_ */
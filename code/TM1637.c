@@ -0,0 +1,163 @@
+#include <util/delay.h>
+#include "display.h"
+
+#define _BV(bit) (1 << (bit))
+
+#define PIN_CLK PORTA4 // USCK
+#define PIN_DIO PORTA5 // DO
+
+#define CMD_DATA     0x40 // Write, address auto increment
+#define CMD_ADDRESS  0xC0 // | grid
+#define CMD_CONTROL  0x80 // | CONTROL_ON | brightness 0-7
+#define CONTROL_ON   0x08
+
+#define GRIDS DISPLAY_MODULE_DIGITS
+
+// Three wire mode, clocked by software: every write of this toggles USCK.
+// The data register shifts on the rising edge, and DO changes on the
+// falling one, so the chip reads a stable bit.
+#define USI_STROBE (_BV(USIWM0) | _BV(USICS1) | _BV(USICLK) | _BV(USITC))
+
+static void _start();
+static void _stop();
+static void _send(uint8_t data);
+static void _shift(uint8_t wire);
+static void _sendGrids(const uint8_t * frame, uint8_t first, uint8_t last);
+static void _sendControl(uint8_t intensity);
+static void _halfClock();
+
+// Ticks until displayBackendScrub rewrites everything
+static uint8_t _scrubTicks;
+
+// Grid of a digit, and digit of a grid: the scores are right to left
+static inline uint8_t _grid(uint8_t digit) {
+  return digit < 4 ? 3 - digit : digit;
+}
+
+void displayBackendSetup(uint8_t intensity) {
+  static const uint8_t blank[GRIDS];
+
+  USICR = 0;
+  DDRA |= _BV(PIN_CLK) | _BV(PIN_DIO);
+  PORTA |= _BV(PIN_CLK);
+  PORTA |= _BV(PIN_DIO);
+
+  _start();
+  _send(CMD_DATA);
+  _stop();
+  _sendGrids(blank, 0, GRIDS - 1);
+  _sendControl(intensity);
+}
+
+// The grids are written with the address auto incrementing, so everything
+// from the first grid that changed to the last one goes out in a single
+// transmission. The brightness needs one of its own.
+void displayBackendCommit(const uint8_t * frame, DisplayMask digits,
+                          uint8_t intensity, bool intensityChanged) {
+  uint8_t first = GRIDS;
+  uint8_t last = 0;
+
+  for (uint8_t i = 0; i < GRIDS; i++) {
+    if (!(digits & (1 << i))) continue;
+    if (_grid(i) < first) first = _grid(i);
+    if (_grid(i) > last) last = _grid(i);
+  }
+
+  if (first < GRIDS) _sendGrids(frame, first, last);
+  if (intensityChanged) _sendControl(intensity);
+}
+
+// Every TM1637_SCRUB_TICKS ticks, the mode, all grids and the brightness go
+// out again. Three transmissions in one tick, rather than one per tick as for
+// the MAX7219, because the chip won't take a single grid for less than a
+// transmission of two bytes anyway.
+void displayBackendScrub(const uint8_t * frame, uint8_t intensity) {
+  if (++_scrubTicks < TM1637_SCRUB_TICKS) return;
+  _scrubTicks = 0;
+
+  _start();
+  _send(CMD_DATA);
+  _stop();
+  _sendGrids(frame, 0, GRIDS - 1);
+  _sendControl(intensity);
+}
+
+// Private methods
+
+// DIO falls while the clock is high. The USI is off here, so the pins follow
+// PORTA, and it's only turned on for the bytes.
+static void _start() {
+  PORTA &= ~_BV(PIN_DIO);
+  _halfClock();
+  PORTA &= ~_BV(PIN_CLK);
+  USIDR = 0;
+  USICR = _BV(USIWM0);
+}
+
+// DIO rises while the clock is high. The last acknowledge left both low.
+static void _stop() {
+  USICR = 0;
+  _halfClock();
+  PORTA |= _BV(PIN_CLK);
+  _halfClock();
+  PORTA |= _BV(PIN_DIO);
+  _halfClock();
+}
+
+// The chip takes the least significant bit first, the USI shifts out the most
+// significant bit first, so commands go out reversed
+static void _send(uint8_t data) {
+  uint8_t reversed = 0;
+
+  for (uint8_t i = 0; i < 8; i++) {
+    reversed = (reversed << 1) | (data & 1);
+    data >>= 1;
+  }
+
+  _shift(reversed);
+}
+
+// Called with the clock low, and leaves it low
+static void _shift(uint8_t wire) {
+  USIDR = wire;
+  for (uint8_t i = 0; i < 15; i++) {
+    _halfClock();
+    USICR = USI_STROBE;
+  }
+
+  // The chip acknowledges by pulling DIO low from the eighth falling edge to
+  // the ninth. DO drives it low as well, rather than turning the pin around,
+  // so it has to be low by the time that edge opens its latch, or it would
+  // fight the chip with whatever came in on DI. With the clock high the
+  // latch still holds the last bit, so clearing it here leaves the bus be.
+  USIDR = 0;
+  for (uint8_t i = 0; i < 3; i++) {
+    _halfClock();
+    USICR = USI_STROBE;
+  }
+}
+
+
+static void _sendGrids(const uint8_t * frame, uint8_t first, uint8_t last) {
+  _start();
+  _send(CMD_ADDRESS | first);
+  for (uint8_t grid = first; grid <= last; grid++) {
+    uint8_t segments = frame[_grid(grid)];
+
+    // The chip has segment A in bit 0 up to G in bit 6, and the decimal
+    // point in bit 7. Reversed, that's the frame's rotated left by one.
+    _shift((segments << 1) | (segments >> 7));
+  }
+  _stop();
+}
+
+// 16 levels of intensity for the MAX7219, 8 for this one
+static void _sendControl(uint8_t intensity) {
+  _start();
+  _send(CMD_CONTROL | CONTROL_ON | intensity >> 1);
+  _stop();
+}
+
+static void _halfClock() {
+  _delay_us(TM1637_HALF_CLOCK_US);
+}
@@ -0,0 +1,26 @@
+#ifndef TM1637_H_
+#define TM1637_H_
+
+#include <stdint.h>
+#include <avr/io.h>
+
+// Display backend for display.h, for the two wire LED driver modules built
+// around a Titan Micro TM1637, in builds made with DISPLAY=TM1637. The clock
+// goes to USCK (PA4) and DIO to DO (PA5), the pins the MAX7219's DIN and CLK
+// use, and bytes are shifted out by the USI in three wire mode. The USI's
+// two wire mode would want SDA on PA6, which the buzzer has.
+//
+// The chip drives up to six digits, its grids. Digits 0-3 are the scores,
+// on grids 4 to 1 (left to right, the way they are on four digit modules),
+// and digits 4 and 5 the indicator LED rows, on grids 5 and 6. One module
+// only: it isn't addressed, so a second table would need a DIO of its own.
+#define DISPLAY_MODULE_DIGITS 6
+#define DISPLAY_MODULES       1
+
+// Half a period of the clock, in microseconds. The chip takes up to 250 kHz.
+#define TM1637_HALF_CLOCK_US 2
+
+// Ticks between rewrites of the whole chip, see displayBackendScrub
+#define TM1637_SCRUB_TICKS 250
+
+#endif /* TM1637_H_ */
@@ -2,131 +2,151 @@
 #include "stdint.h"
 #include "stddef.h"
 #include "stdbool.h"
-#include "MAX72S19.h"
+#include "display.h"
 #include "pingpong.h"
-#include "tonegen.h"
-
-static volatile Animation * _activeAnimation;
-static volatile Animation * _activeMelodyAnimation;
-
-static Animation _startupAnim, _player1WonAnim, _player2WonAnim;
-
-static void _startupFrame(Animation *);
-static void _player1WinFrame(Animation *);
-static void _player2WinFrame(Animation *);
-static void _winFrame(Animation *, uint8_t);
-static void _animTick(Animation *, uint32_t);
-static void _animClear(Animation *);
+#include "task.h"
+#include "settings.h"
+#include "timing.h"
+#include "trace.h"
+
+#define STARTUP_STEP_TICKS TIMING_MS_TO_TICKS(20)
+// Fade steps: in and out on "Ping", in and out on "Pong", in on the game
+#define STARTUP_STEPS      0x4F
+#define STARTUP_PONG_STEP  0x20
+#define STARTUP_GAME_STEP  0x40
+
+#define WIN_STEP_TICKS TIMING_MS_TO_TICKS(200)
+#define WIN_BLINKS     20 // On and off count as one each
+
+// Tables the startup animation plays on at once, as many as fit the pins
+#define STARTUP_TABLES 2
+
+static void _startupTask(Task *);
+static void _winTask(Task *);
+static uint8_t _startupIntensity(uint8_t step);
+static void _startupWrite(uint8_t digit, char character);
+static void _startupDone();
+
+// Only one animation plays at a time
+static Task _task;
+static Animations _playing;
+static void * _context;
+// How far into the animation, doesn't survive a wait otherwise
+static uint8_t _step;
+// Every table that started up, the startup animation plays on all of them
+static void * _startupTables[STARTUP_TABLES];
+static uint8_t _startupCount;
 
 void animationInit() {
-  // Set up animation structs
-  _startupAnim.stepTicks = 10;
-  _startupAnim.duration = 0x4F;
-  _startupAnim.frame = (animatorFunction)_startupFrame;
-
-  _player1WonAnim.stepTicks = 100;
-  _player1WonAnim.duration = 20;
-  _player1WonAnim.frame = (animatorFunction)_player1WinFrame;
-
-  _player2WonAnim.stepTicks = 100;
-  _player2WonAnim.duration = 20;
-  _player2WonAnim.frame = (animatorFunction)_player2WinFrame;
-}
-
-void animationTick(uint32_t ticks) {
-  _animTick(_activeMelodyAnimation, ticks);
-  _animTick(_activeAnimation, ticks);
-}
-
-void animationSetActive(Animation * anim) {
-  _activeAnimation = anim;
-}
-
-void animationSetActiveMelody(Animation * meloAnim) {
-  _activeMelodyAnimation = meloAnim;
+  // Nothing to set up at runtime, animations are tasks started by trigger
 }
 
 void animationClear() {
-  _animClear(_activeAnimation);
-  _activeAnimation = NULL;
-  _animClear(_activeMelodyAnimation);
-  _activeMelodyAnimation = NULL;
-  TONEGEN_OFF();
+  if (!taskIsRunning(&_task)) return;
+  taskStop(&_task);
+  TRACE(TRACE_EVT_ANIM_STOP, _playing);
+
+  switch (_playing) {
+    case Startup:
+      displaySetIntensity(_startupIntensity(STARTUP_STEPS - 1));
+      _startupDone();
+      break;
+
+    case Player1Win:
+    case Player2Win:
+      pingpongIndicatePlayerTurn(_context, PINGPONG_PLAYER_NONE);
+      break;
+  }
 }
 
-void animationTrigger(Animations animEnum) {
-  Animation * anim = NULL;
-
-  switch (animEnum) {
-    case Startup: anim = &_startupAnim; break;
-    case Player1Win: anim = &_player1WonAnim; break;
-    case Player2Win: anim = &_player2WonAnim; break;
-    default: return;
+// A table starting up while another one is joins its startup, which starts
+// over for both. Anything else ends whatever was playing first, as if
+// cleared, so no table is left half way through an animation.
+void animationTrigger(Animations anim, void * context) {
+  if (anim == Startup && _playing == Startup && taskIsRunning(&_task)
+      && _startupCount < STARTUP_TABLES) {
+    _startupTables[_startupCount++] = context;
+  } else {
+    animationClear();
+    _startupTables[0] = context;
+    _startupCount = 1;
   }
 
-  anim->position = 0;
-  animationSetActive(anim);
+  TRACE(TRACE_EVT_ANIM_START, anim);
+  _playing = anim;
+  _context = context;
+  taskStart(&_task, anim == Startup ? _startupTask : _winTask);
 }
 
-void _animTick(Animation * anim, uint32_t ticks) {
-  if (anim == NULL) return;
+// Animation implementations ---------------------------------------------------
 
-  if (ticks % anim->stepTicks != 0) return;
+static void _startupTask(Task * task) {
+  TASK_BEGIN(task);
 
-  if (anim->duration == anim->position) {
-    if (anim == _activeAnimation) _activeAnimation = NULL;
-    if (anim == _activeMelodyAnimation) _activeMelodyAnimation = NULL;
-    return;
-  }
+  _startupWrite(3, 'P');
+  _startupWrite(2, 'i');
+  _startupWrite(1, 'n');
+  _startupWrite(0, 'g');
 
-  anim->frame(anim);
-  anim->position++;
-}
+  for (_step = 0; _step < STARTUP_STEPS; _step++) {
+    if (_step == STARTUP_PONG_STEP) {
+      _startupWrite(2, 'o');
+    } else if (_step == STARTUP_GAME_STEP) {
+      _startupDone();
+    }
 
-void _animClear(Animation * anim) {
-  if (anim == NULL) return;
-  anim->position = anim->duration -1;
-  anim->frame(anim);
-}
+    displaySetIntensity(_startupIntensity(_step));
+    TASK_WAIT_TICKS(task, STARTUP_STEP_TICKS);
+  }
 
-// Animation implementations ---------------------------------------------------
+  TRACE(TRACE_EVT_ANIM_STOP, _playing);
+  TASK_END(task);
+}
 
+// Fades in over 16 steps, then out, then in again... up to the brightness in
+// settings
+static uint8_t _startupIntensity(uint8_t step) {
+  uint8_t level;
 
-static void _startupFrame(Animation * a) {
-  uint32_t pos = a->position;
+  step++;
 
-  if (pos == 0) {
-    displayWriteChar(3, 'P', false);
-    displayWriteChar(2, 'i', false);
-    displayWriteChar(1, 'n', false);
-    displayWriteChar(0, 'g', false);
-  } else  if (pos == 0x20) {
-    displayWriteChar(2, 'o', false);
-  } else if (pos >= 0x40) {
-    pingpongSetMode(PINGPONG_DISPMODE_GAME);
+  if (step < 0x10
+      || (step >= 0x20 && step < 0x30)
+      || (step >= 0x40)) {
+    level = step % 0x10;
+  } else {
+    level = 0xF - (step % 0x10);
   }
 
-  // Note: actual position is incremented by animation system
-  pos++;
+  return (level * (settings.brightness + 1)) >> 4;
+}
 
-  if (pos < 0x10
-      || (pos >= 0x20 && pos < 0x30)
-      || (pos >= 0x40)) {
-    displaySetIntensity(pos % 0x10);
-  } else {
-    displaySetIntensity(0xF - (pos % 0x10));
+static void _startupWrite(uint8_t digit, char character) {
+  for (uint8_t i = 0; i < _startupCount; i++) {
+    displayWriteChar(pingpongDigit(_startupTables[i], digit), character, false);
   }
 }
 
-static void _player1WinFrame(Animation * a) {
-  _winFrame(a, PINGPONG_PLAYER_1);
+// Every table on to its game
+static void _startupDone() {
+  for (uint8_t i = 0; i < _startupCount; i++) {
+    pingpongSetMode(_startupTables[i], PINGPONG_DISPMODE_GAME);
+  }
 }
 
-static void _player2WinFrame(Animation * a) {
-  _winFrame(a, PINGPONG_PLAYER_2);
-}
+static void _winTask(Task * task) {
+  uint8_t player = _playing == Player1Win
+    ? PINGPONG_PLAYER_1
+    : PINGPONG_PLAYER_2;
+
+  TASK_BEGIN(task);
+
+  for (_step = 0; _step < WIN_BLINKS; _step++) {
+    pingpongIndicatePlayerTurn(
+        _context, _step % 2 == 0 ? player : PINGPONG_PLAYER_NONE);
+    TASK_WAIT_TICKS(task, WIN_STEP_TICKS);
+  }
 
-static void _winFrame(Animation * a, uint8_t player) {
-  bool ledOn = a->position % 2 == 0;
-  pingpongIndicatePlayerTurn(ledOn ? player : PINGPONG_PLAYER_NONE);
+  TRACE(TRACE_EVT_ANIM_STOP, _playing);
+  TASK_END(task);
 }
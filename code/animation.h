@@ -3,27 +3,20 @@
 
 #include "stdint.h"
 
-struct Animation;
-typedef void (*animatorFunction)(struct Animation *);
-
 typedef enum {
   Startup,
   Player1Win,
   Player2Win,
 } Animations;
 
-typedef struct Animation {
-  uint16_t stepTicks; // Number of ticks between "frames"
-  int32_t duration; // Number of frames, -1 for infinite
-  uint32_t position; // How many ticks into the animation
-  animatorFunction frame;
-} Animation;
-
 void animationInit();
-void animationTick(uint32_t);
-void animationSetActive(Animation *);
-void animationSetActiveMelody(Animation *);
+
+// Stops whatever animation is playing, leaving the display as it would be at
+// the end of it. Melodies play on, they end by themselves.
 void animationClear();
-void animationTrigger(Animations);
+
+// Plays an animation, as a task (see task.h). The context is whatever it
+// draws on, the table for all of the built-in ones.
+void animationTrigger(Animations, void *);
 
 #endif
@@ -7,13 +7,15 @@
 // Describes a button, abstracting the implementation details for debounce,
 // press, and long press so pingpong.c can focus mostly on game logic
 typedef struct {
-  // Port A pin this button is for
+  // Pin this button is for: 0-7 on port A, 8-15 for pins 0-7 on port B
   uint8_t pin;
 
-  // Tick count when this was last has a debounced down-going flank
-  uint64_t lastDown;
+  // Low 16 bits of the tick count when this last had a down-going flank.
+  // Only ever compared as a difference to the current tick count, so 16 bits
+  // is plenty for the few seconds we care about.
+  uint16_t lastDown;
 
-  uint64_t lastUp;
+  uint16_t lastUp;
 
   // Whether the button is currently down
   bool down;
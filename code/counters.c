@@ -0,0 +1,225 @@
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "counters.h"
+#include "display.h"
+#include "crc.h"
+#include "stackmon.h"
+#include "task.h"
+#include "timing.h"
+#include "stddef.h"
+
+#define MINUTE_TICKS (60 * TIMING_TICKS_PER_SECOND)
+
+// How long the name of a counter shows before its value, and how often the
+// value is brought up to date after that
+#define PAGE_LABEL_TICKS   TIMING_MS_TO_TICKS(1000)
+#define PAGE_REFRESH_TICKS TIMING_MS_TO_TICKS(1000)
+
+#define PAGE_MAX_VALUE 9999
+
+// A counter on the diagnostics page
+typedef struct {
+  char label[2];
+  uint8_t offset; // In Counters
+} CountersItem;
+
+static const CountersItem _items[] PROGMEM = {
+  { { 'u', 'P' }, offsetof(Counters, uptimeHours) },
+  { { 'r', 'P' }, offsetof(Counters, resets[COUNTERS_RESET_POWERON]) },
+  { { 'r', 'E' }, offsetof(Counters, resets[COUNTERS_RESET_EXTERNAL]) },
+  { { 'r', 'b' }, offsetof(Counters, resets[COUNTERS_RESET_BROWNOUT]) },
+  { { 'r', 'd' }, offsetof(Counters, resets[COUNTERS_RESET_WATCHDOG]) },
+  { { 'G', 'A' }, offsetof(Counters, gamesPlayed) },
+  { { 'E', 'E' }, offsetof(Counters, eepromWrites) },
+  { { 't', 'o' }, offsetof(Counters, tickOverruns) },
+  { { 't', 'd' }, offsetof(Counters, maxTickUs) },
+  // The decimal point is on if the stack monitor latched a fault
+  { { 'S', 'F' }, offsetof(Counters, stackMinFree) },
+};
+
+#define ITEMS (sizeof(_items) / sizeof(CountersItem))
+
+// Not initialised by the C runtime, so counts since the last save survive a
+// warm reset, see countersInit
+static Counters _counters __attribute__((section(".noinit")));
+
+static Task _uptimeTask;
+static uint8_t _minutes;
+
+static Task _pageTask;
+static uint8_t _pageItem;
+static uint8_t _pageDigit;
+
+static void _uptime(Task *);
+static void _page(Task *);
+static void _showLabel();
+static void _showValue();
+static void _increment(uint16_t * counter);
+static void _updateStackMinFree();
+static void _seal();
+static uint8_t _crc();
+
+void countersInit(uint8_t resetCause, bool warmStart) {
+  if (!warmStart || _counters.crc != _crc()) {
+    eeprom_read_block(
+        &_counters, (const void *)COUNTERS_EEPROM_ADDR, sizeof(Counters));
+  }
+
+  if (_counters.crc != _crc()) {
+    // Never saved, or corrupted. Start over.
+    for (uint8_t i = 0; i < sizeof(Counters); i++) {
+      ((uint8_t *)&_counters)[i] = 0;
+    }
+    _counters.stackMinFree = 0xFFFF;
+  }
+
+  for (uint8_t i = 0; i < COUNTERS_RESET_CAUSES; i++) {
+    if (resetCause & (1 << i)) _increment(&_counters.resets[i]);
+  }
+
+  _seal();
+  taskStart(&_uptimeTask, _uptime);
+}
+
+void countersGameEnded() {
+  _increment(&_counters.gamesPlayed);
+}
+
+void countersGameUndone() {
+  if (_counters.gamesPlayed == 0) return;
+
+  _counters.gamesPlayed--;
+  _seal();
+}
+
+void countersEepromWrite() {
+  _increment(&_counters.eepromWrites);
+}
+
+void countersTickOverrun() {
+  _increment(&_counters.tickOverruns);
+}
+
+// Called every pass of the main loop, only seals when there's a new maximum
+void countersTickDuration(uint16_t us) {
+  if (us <= _counters.maxTickUs) return;
+
+  _counters.maxTickUs = us;
+  _seal();
+}
+
+void countersSave() {
+  _updateStackMinFree();
+  // Counts itself
+  _increment(&_counters.eepromWrites);
+  // Only bytes that changed are written
+  eeprom_update_block(
+      &_counters, (void *)COUNTERS_EEPROM_ADDR, sizeof(Counters));
+}
+
+void countersPageOpen(uint8_t firstDigit) {
+  _pageDigit = firstDigit;
+  _pageItem = 0;
+  displaySetRow(_pageDigit + 4, 0);
+  displaySetRow(_pageDigit + 5, 0);
+  taskStart(&_pageTask, _page);
+}
+
+void countersPageNext() {
+  if (++_pageItem >= ITEMS) _pageItem = 0;
+  taskStart(&_pageTask, _page);
+}
+
+void countersPageClose() {
+  taskStop(&_pageTask);
+}
+
+// An hour is too long for a single wait, so it's counted in minutes
+static void _uptime(Task * task) {
+  TASK_BEGIN(task);
+
+  for (;;) {
+    for (_minutes = 0; _minutes < 60; _minutes++) {
+      TASK_WAIT_TICKS(task, MINUTE_TICKS);
+    }
+
+    _increment(&_counters.uptimeHours);
+  }
+
+  TASK_END(task);
+}
+
+static void _page(Task * task) {
+  TASK_BEGIN(task);
+
+  _showLabel();
+  TASK_WAIT_TICKS(task, PAGE_LABEL_TICKS);
+
+  for (;;) {
+    _showValue();
+    TASK_WAIT_TICKS(task, PAGE_REFRESH_TICKS);
+  }
+
+  TASK_END(task);
+}
+
+static void _showLabel() {
+  CountersItem item;
+
+  memcpy_P(&item, &_items[_pageItem], sizeof(CountersItem));
+
+  displayWriteChar(_pageDigit + 3, item.label[0], false);
+  displayWriteChar(_pageDigit + 2, item.label[1], false);
+  displayWriteChar(_pageDigit + 1, ' ', false);
+  displayWriteChar(_pageDigit, ' ', false);
+}
+
+static void _showValue() {
+  CountersItem item;
+  uint16_t value;
+  bool dot = false;
+
+  memcpy_P(&item, &_items[_pageItem], sizeof(CountersItem));
+
+  if (item.offset == offsetof(Counters, stackMinFree)) {
+    _updateStackMinFree();
+    dot = stackmonFault();
+  }
+
+  value = *(uint16_t *)((uint8_t *)&_counters + item.offset);
+  if (value > PAGE_MAX_VALUE) value = PAGE_MAX_VALUE;
+
+  // Right aligned, without leading zeros
+  for (uint8_t i = 0; i < 4; i++) {
+    displayWriteChar(
+        _pageDigit + i,
+        value == 0 && i > 0 ? ' ' : '0' + value % 10,
+        dot && i == 0);
+    value /= 10;
+  }
+}
+
+// Saturates rather than wrapping around to 0
+static void _increment(uint16_t * counter) {
+  if (*counter == 0xFFFF) return;
+
+  (*counter)++;
+  _seal();
+}
+
+static void _updateStackMinFree() {
+  uint16_t minFree = stackmonMinFree();
+
+  if (minFree >= _counters.stackMinFree) return;
+
+  _counters.stackMinFree = minFree;
+  _seal();
+}
+
+static void _seal() {
+  _counters.crc = _crc();
+}
+
+static uint8_t _crc() {
+  return crc8(&_counters, offsetof(Counters, crc));
+}
@@ -0,0 +1,58 @@
+#ifndef COUNTERS_H_
+#define COUNTERS_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Lifetime counters, for finding out how a table has been doing in the field.
+//
+// Counted in RAM, and written to EEPROM only when the all time scores are, see
+// countersSave. Nothing here ever causes an EEPROM write of its own, so they
+// cost no extra wear; the price is that what happened since the last save is
+// lost on power off. The RAM copy is in .noinit with a CRC, like the game, so
+// it does survive a warm reset, and that's what ends up counted.
+
+// After the settings
+#define COUNTERS_EEPROM_ADDR 0x30
+
+// Reset causes, in the order of their MCUSR bits
+#define COUNTERS_RESET_POWERON  0 // PORF
+#define COUNTERS_RESET_EXTERNAL 1 // EXTRF
+#define COUNTERS_RESET_BROWNOUT 2 // BORF
+#define COUNTERS_RESET_WATCHDOG 3 // WDRF
+#define COUNTERS_RESET_CAUSES   4
+
+typedef struct {
+  uint16_t uptimeHours;
+  uint16_t resets[COUNTERS_RESET_CAUSES];
+  uint16_t gamesPlayed;
+  uint16_t eepromWrites; // Write operations, including the counters' own
+  uint16_t tickOverruns;
+  uint16_t maxTickUs; // Longest pass of the main loop, in microseconds
+  uint16_t stackMinFree; // Lowest stackmonMinFree ever seen
+  uint8_t crc;
+} Counters;
+
+// Loads the counters, and counts the reset that got us here. resetCause is
+// MCUSR as it was at reset.
+void countersInit(uint8_t resetCause, bool warmStart);
+
+void countersGameEnded();
+// When the end of a game is undone
+void countersGameUndone();
+void countersEepromWrite();
+void countersTickOverrun();
+void countersTickDuration(uint16_t us);
+
+// Writes the counters to EEPROM. Only to be called right after the all time
+// scores were written, so they are saved no more often than those.
+void countersSave();
+
+// The diagnostics page, on four digits starting at firstDigit. Shows one
+// counter at a time: a two letter name for a moment, then its value. Values
+// over 9999 show as 9999.
+void countersPageOpen(uint8_t firstDigit);
+void countersPageNext();
+void countersPageClose();
+
+#endif // COUNTERS_H_
@@ -0,0 +1,13 @@
+#include <util/crc16.h>
+#include "crc.h"
+
+uint8_t crc8(const void * data, uint8_t length) {
+  const uint8_t * bytes = data;
+  uint8_t crc = 0;
+
+  for (uint8_t i = 0; i < length; i++) {
+    crc = _crc_ibutton_update(crc, bytes[i]);
+  }
+
+  return crc;
+}
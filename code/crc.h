@@ -0,0 +1,11 @@
+#ifndef CRC_H_
+#define CRC_H_
+
+#include "stdint.h"
+
+// CRC8 (Dallas/Maxim, as in _crc_ibutton_update) over the first length bytes
+// at data. What's kept in .noinit or EEPROM is sealed with it: the struct up
+// to its crc field, offsetof(Type, crc) bytes, so the field comes last.
+uint8_t crc8(const void * data, uint8_t length);
+
+#endif // CRC_H_
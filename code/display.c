@@ -0,0 +1,131 @@
+#include "display.h"
+
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#ifdef DISPLAY_TRACE
+#define TRACE_CHANGE(digit) displayTraceChange(digit)
+#else
+#define TRACE_CHANGE(digit)
+#endif
+
+static void _setDigit(uint8_t digit, uint8_t data);
+
+// What should be on the display, and what of it the backend doesn't have yet
+static uint8_t _frame[DISPLAY_DIGITS];
+static DisplayMask _dirty;
+static uint8_t _intensity;
+static bool _intensityDirty;
+
+void displaySetup(uint8_t intensity) {
+  _intensity = constrain(intensity, 0x0, 0xF);
+  _intensityDirty = false;
+  for (uint8_t i = 0; i < DISPLAY_DIGITS; i++) _frame[i] = 0x00;
+  _dirty = 0;
+
+  displayBackendSetup(_intensity);
+}
+
+void displaySetLED(uint8_t row, uint8_t column, bool on) {
+  if (row >= DISPLAY_DIGITS) return;
+
+  if (on) {
+    _setDigit(row, _frame[row] | (1 << column));
+  } else {
+    _setDigit(row, _frame[row] & ~(1 << column));
+  }
+}
+
+void displaySetRow(uint8_t row, uint8_t states) {
+  _setDigit(row, states);
+}
+
+// Every digit goes out again at the next commit, blank or not, rather than
+// relying on the chips holding what we think they do
+void displayClear() {
+  for (uint8_t i = 0; i < DISPLAY_DIGITS; i++) {
+    _frame[i] = 0x00;
+    TRACE_CHANGE(i);
+  }
+
+  _dirty = (DisplayMask)~0;
+}
+
+void displayWriteChar(uint8_t digitIndex, char character, bool dotOn) {
+  digitIndex = constrain(digitIndex, 0, DISPLAY_DIGITS - 1);
+  uint8_t value = displayGlyph(character);
+
+  if (dotOn) {
+    value |= 0b10000000;
+  }
+
+  _setDigit(digitIndex, value);
+}
+
+void displayWriteNumber(uint8_t digitIndex, uint8_t number) {
+  number = constrain(number, 0, 9);
+  displayWriteChar(digitIndex, '0' + number, false);
+}
+
+void displaySetIntensity(uint8_t intensity) {
+  intensity = constrain(intensity, 0x0, 0xF);
+  if (intensity == _intensity) return;
+
+  _intensity = intensity;
+  _intensityDirty = true;
+  TRACE_CHANGE(DISPLAY_DIGITS);
+}
+
+void displayCommit() {
+  if (_dirty || _intensityDirty) {
+    displayBackendCommit(_frame, _dirty, _intensity, _intensityDirty);
+    _dirty = 0;
+    _intensityDirty = false;
+  }
+
+  displayBackendScrub(_frame, _intensity);
+}
+
+uint8_t displayGlyph(char inputChar) {
+  switch (inputChar) {
+    //                dpABCDEFG
+    case '0': return 0b01111110;
+    case '1': return 0b00110000;
+    case '2': return 0b01101101;
+    case '3': return 0b01111001;
+    case '4': return 0b00110011;
+    case '5': return 0b01011011;
+    case '6': return 0b01011111;
+    case '7': return 0b01110000;
+    case '8': return 0b01111111;
+    case '9': return 0b01111011;
+    case 'P': return 0b01100111;
+    case 'i': return 0b00010000;
+    case 'n': return 0b00010101;
+    case 'g': return 0b01111011;
+    case 'o': return 0b00011101;
+    case 't': return 0b00001111;
+    case 'S': return 0b01011011;
+    case 'r': return 0b00000101;
+    case 'b': return 0b00011111;
+    case 'A': return 0b01110111;
+    case 'u': return 0b00011100;
+    case 'E': return 0b01001111;
+    case 'G': return 0b01011110;
+    case 'd': return 0b00111101;
+    case 'F': return 0b01000111;
+    case 'C': return 0b01001110;
+    default:  return 0b00000000;
+  }
+}
+
+// Private methods
+
+// Digits that end up as they were, drawn over within a tick, still go out
+static void _setDigit(uint8_t digit, uint8_t data) {
+  if (digit >= DISPLAY_DIGITS) return;
+  if (data == _frame[digit]) return;
+
+  _frame[digit] = data;
+  _dirty |= (DisplayMask)1 << digit;
+  TRACE_CHANGE(digit);
+}
@@ -0,0 +1,83 @@
+#ifndef DISPLAY_H_
+#define DISPLAY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// The display as the rest of the firmware sees it: a frame of digits, each a
+// glyph (segments, see displayGlyph) or a row of LEDs, and a brightness.
+// Drawing only changes the frame. displayCommit, once a tick, hands whatever
+// changed to the backend, the driver of the display chip, which puts it on
+// the bus in as few transactions as its protocol allows. The backend is
+// picked at build time, "make DISPLAY=...", and its header sets the shape of
+// the display:
+//
+//   DISPLAY_MODULE_DIGITS  digits per chip, or module
+//   DISPLAY_MODULES        chips, daisy chained or otherwise
+//
+// Digits are numbered across all of them, 0 to DISPLAY_MODULE_DIGITS - 1 on
+// the first one and so on.
+#if defined(DISPLAY_TM1637)
+#include "TM1637.h"
+#else
+#include "MAX72S19.h"
+#endif
+
+#define DISPLAY_DIGITS (DISPLAY_MODULE_DIGITS * DISPLAY_MODULES)
+
+// A bit per digit
+#if DISPLAY_DIGITS > 16
+#error "Up to 16 display digits are supported"
+#elif DISPLAY_DIGITS > 8
+typedef uint16_t DisplayMask;
+#else
+typedef uint8_t DisplayMask;
+#endif
+
+// Brings up the backend with a blank display, at the given brightness, 0-15
+void displaySetup(uint8_t intensity);
+void displaySetLED(uint8_t row, uint8_t column, bool on);
+void displaySetRow(uint8_t row, uint8_t states);
+void displayClear();
+void displayWriteChar(uint8_t digitIndex, char character, bool dotOn);
+void displayWriteNumber(uint8_t digitIndex, uint8_t number);
+void displaySetIntensity(uint8_t intensity);
+// Sends what changed since the last commit to the display, then lets the
+// backend rewrite a bit of what it didn't, see displayBackendScrub
+void displayCommit();
+
+// Segments lit for a character, 0 if there's no glyph for it. Bit 7 is the
+// decimal point, bits 6 to 0 segments A to G:
+//
+//          _______
+//        /   A   /
+//     F /       / B
+//      /_______/
+//     /   G   /
+//  E /       / C
+//   /_______/ * dp
+//       D
+uint8_t displayGlyph(char);
+
+// Implemented by the backend. The frame is DISPLAY_DIGITS long, in the layout
+// above; LED rows are in it as they are, so LEDs are wired to the segment
+// lines of their digit.
+//
+// Setup brings up the bus and the chips, with a blank display at the given
+// intensity. Commit sends the digits set in the mask, and the intensity if
+// it changed. Scrub is called every tick after that, for the backend to
+// rewrite some of what it holds, so a chip whose registers got corrupted
+// (ESD from a paddle hitting the table, a brownout) heals on its own.
+void displayBackendSetup(uint8_t intensity);
+void displayBackendCommit(const uint8_t * frame, DisplayMask digits,
+                          uint8_t intensity, bool intensityChanged);
+void displayBackendScrub(const uint8_t * frame, uint8_t intensity);
+
+#ifdef DISPLAY_TRACE
+// Called whenever drawing changes a digit of the frame, or the intensity with
+// DISPLAY_DIGITS. Implemented by host side tools, to tell who asked for the
+// write that goes out at the next commit, see host/bus-analyzer.c
+void displayTraceChange(uint8_t digit);
+#endif
+
+#endif /* DISPLAY_H_ */
@@ -0,0 +1,77 @@
+// Definitions behind host/include/avr, see avr/io.h there
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <string.h>
+#include "../stackmon.h"
+
+#define HOST_DEFINE_REG8(name) volatile uint8_t name;
+#define HOST_DEFINE_REG16(name) volatile uint16_t name;
+
+HOST_DEFINE_REG8(PORTA) HOST_DEFINE_REG8(DDRA) HOST_DEFINE_REG8(PINA)
+HOST_DEFINE_REG8(PORTB) HOST_DEFINE_REG8(DDRB) HOST_DEFINE_REG8(PINB)
+HOST_DEFINE_REG8(TCCR0A) HOST_DEFINE_REG8(TCCR0B) HOST_DEFINE_REG8(TCNT0)
+HOST_DEFINE_REG8(OCR0A) HOST_DEFINE_REG8(OCR0B)
+HOST_DEFINE_REG8(TIMSK0) HOST_DEFINE_REG8(TIFR0)
+HOST_DEFINE_REG8(TCCR1A) HOST_DEFINE_REG8(TCCR1B) HOST_DEFINE_REG8(TCCR1C)
+HOST_DEFINE_REG8(TIMSK1) HOST_DEFINE_REG8(TIFR1)
+HOST_DEFINE_REG16(TCNT1) HOST_DEFINE_REG16(OCR1A) HOST_DEFINE_REG16(OCR1B)
+HOST_DEFINE_REG16(ICR1)
+HOST_DEFINE_REG8(GIMSK) HOST_DEFINE_REG8(PCMSK0) HOST_DEFINE_REG8(PCMSK1)
+HOST_DEFINE_REG8(MCUSR) HOST_DEFINE_REG8(CLKPR) HOST_DEFINE_REG8(SREG)
+HOST_DEFINE_REG8(GPIOR0) HOST_DEFINE_REG8(GPIOR1) HOST_DEFINE_REG8(GPIOR2)
+HOST_DEFINE_REG8(USICR) HOST_DEFINE_REG8(USISR) HOST_DEFINE_REG8(USIDR)
+
+// Erased EEPROM reads as 0xFF, set up by hostEepromErase
+uint8_t hostEeprom[E2END + 1];
+unsigned long hostEepromWrites;
+
+void hostEepromErase() {
+  memset(hostEeprom, 0xFF, sizeof(hostEeprom));
+}
+
+uint8_t eeprom_read_byte(const uint8_t * addr) {
+  return hostEeprom[(uintptr_t)addr & E2END];
+}
+
+uint16_t eeprom_read_word(const uint16_t * addr) {
+  uintptr_t a = (uintptr_t)addr;
+  return hostEeprom[a & E2END] | (hostEeprom[(a + 1) & E2END] << 8);
+}
+
+void eeprom_read_block(void * dst, const void * src, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    ((uint8_t *)dst)[i] = hostEeprom[((uintptr_t)src + i) & E2END];
+  }
+}
+
+void eeprom_write_byte(uint8_t * addr, uint8_t value) {
+  hostEeprom[(uintptr_t)addr & E2END] = value;
+  hostEepromWrites++;
+}
+
+void eeprom_write_word(uint16_t * addr, uint16_t value) {
+  eeprom_write_byte((uint8_t *)addr, value & 0xFF);
+  eeprom_write_byte((uint8_t *)addr + 1, value >> 8);
+}
+
+void eeprom_update_byte(uint8_t * addr, uint8_t value) {
+  if (eeprom_read_byte(addr) != value) eeprom_write_byte(addr, value);
+}
+
+void eeprom_update_word(uint16_t * addr, uint16_t value) {
+  eeprom_update_byte((uint8_t *)addr, value & 0xFF);
+  eeprom_update_byte((uint8_t *)addr + 1, value >> 8);
+}
+
+void eeprom_update_block(const void * src, void * dst, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    eeprom_update_byte((uint8_t *)dst + i, ((const uint8_t *)src)[i]);
+  }
+}
+
+// stackmon.c paints and measures the AVR's own SRAM, there is nothing to
+// measure on the host
+void stackmonCheck() {}
+uint16_t stackmonMinFree() { return 0xFFFF; }
+bool stackmonFault() { return false; }
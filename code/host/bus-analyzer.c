@@ -0,0 +1,548 @@
+// Display bus traffic analyzer.
+//
+// Runs the firmware in the host simulation (sim.h) through a scenario and
+// logs every register write the MAX7219 driver puts on the bus: when it
+// happened, which register, what value, and which firmware function asked
+// for it, by drawing what the write sends (see display.h). From that it
+// reports how busy the bus is, how many writes didn't change anything, how
+// many writes each kind of event costs, and the worst burst of writes in a
+// single tick.
+//
+// Usage: bus-analyzer [-c cycles] [-l log.csv] [-v trace.vcd] [scenario]
+//
+//   -c cycles    CPU cycles one register write takes on the board, used for
+//                timestamps and bus utilization. The default is an estimate
+//                for the bit-banged driver at -Os, measure with a scope on
+//                CS to refine it.
+//   -l log.csv   every write, one per line
+//   -v trace.vcd every write as a waveform: chip select, register, data and
+//                a redundant flag, with the origin as a comment
+//   scenario     script as described in scenario.h, defaults to a built-in
+//                one covering a whole game
+//
+// Call sites come from -finstrument-functions: the firmware sources are
+// compiled with it, and the hooks below keep a shadow call stack. Names are
+// looked up from the executable's own symbol table with nm, so the tool is
+// linked without PIE.
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "scenario.h"
+#include "sim.h"
+#include "../timing.h"
+#include "../display.h"
+
+#define NOINSTR __attribute__((no_instrument_function))
+
+#define DEFAULT_CYCLES_PER_WRITE 600
+
+#define MAX_DEPTH     64
+#define MAX_SYMBOLS   1024
+#define MAX_NAMES     256
+#define MAX_REGISTERS 16
+#define MAX_PHASES    32
+#define BURST_BUCKETS 12
+
+//------------------------------------------------------------------------------
+// Symbols
+//------------------------------------------------------------------------------
+
+typedef struct {
+  uintptr_t address;
+  char name[48];
+} Symbol;
+
+static Symbol _symbols[MAX_SYMBOLS];
+static unsigned _symbolCount;
+
+NOINSTR static int _compareSymbols(const void * a, const void * b) {
+  uintptr_t x = ((const Symbol *)a)->address;
+  uintptr_t y = ((const Symbol *)b)->address;
+
+  return x < y ? -1 : x > y;
+}
+
+NOINSTR static void _loadSymbols() {
+  char line[256];
+  char exe[4096];
+  char command[4200];
+  ssize_t length = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+  FILE * nm;
+
+  // Resolved here, in nm's own process /proc/self would be nm
+  if (length < 0) return;
+  exe[length] = '\0';
+
+  snprintf(command, sizeof(command), "nm --defined-only '%s'", exe);
+  nm = popen(command, "r");
+  if (nm == NULL) return;
+
+  while (fgets(line, sizeof(line), nm) != NULL && _symbolCount < MAX_SYMBOLS) {
+    unsigned long long address;
+    char type;
+    Symbol * symbol = &_symbols[_symbolCount];
+
+    if (sscanf(line, "%llx %c %47s", &address, &type, symbol->name) != 3) {
+      continue;
+    }
+    if (type != 't' && type != 'T') continue;
+
+    symbol->address = (uintptr_t)address;
+    _symbolCount++;
+  }
+
+  pclose(nm);
+  qsort(_symbols, _symbolCount, sizeof(Symbol), _compareSymbols);
+}
+
+NOINSTR static const char * _symbolName(void * fn) {
+  uintptr_t address = (uintptr_t)fn;
+  unsigned low = 0;
+  unsigned high = _symbolCount;
+
+  // Exact match, the hooks are passed function entry points
+  while (low < high) {
+    unsigned mid = (low + high) / 2;
+
+    if (_symbols[mid].address == address) return _symbols[mid].name;
+    if (_symbols[mid].address < address) low = mid + 1;
+    else high = mid;
+  }
+
+  return "?";
+}
+
+//------------------------------------------------------------------------------
+// Shadow call stack
+//------------------------------------------------------------------------------
+
+static const char * _stack[MAX_DEPTH];
+static unsigned _depth;
+
+// Functions that are part of getting a write onto the bus rather than a
+// reason for it. Scrubbing is the driver's own idea, so it counts as an origin.
+NOINSTR static bool _isDriver(const char * name) {
+  return (strncmp(name, "display", 7) == 0
+          && strcmp(name, "displayBackendScrub") != 0)
+      || strcmp(name, "_setDigit") == 0
+      || strcmp(name, "_setRegister") == 0
+      || strcmp(name, "_setControl") == 0
+      || strcmp(name, "_shiftOut") == 0
+      || strcmp(name, "_beginTransmission") == 0
+      || strcmp(name, "_endTransmission") == 0;
+}
+
+// Frames that only dispatch: the simulation, main loop and interrupts
+NOINSTR static bool _isPlumbing(const char * name) {
+  return strncmp(name, "sim", 3) == 0
+      || strncmp(name, "scenario", 8) == 0
+      || strcmp(name, "firmwareMain") == 0
+      || strcmp(name, "_setup") == 0
+      || strcmp(name, "_loop") == 0
+      || strcmp(name, "_tick") == 0
+      || strcmp(name, "_checkButtons") == 0
+      || strcmp(name, "displayCommit") == 0
+      || strcmp(name, "_onPinChangeA") == 0
+      || strstr(name, "_vect") != NULL;
+}
+
+//------------------------------------------------------------------------------
+// Statistics
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char * name;
+  unsigned long calls;
+  unsigned long writes;
+  unsigned long redundant;
+} Counter;
+
+static Counter _origins[MAX_NAMES];
+static Counter _events[MAX_NAMES];
+static Counter _phases[MAX_PHASES];
+static unsigned _originCount;
+static unsigned _eventCount;
+static unsigned _phaseCount;
+
+// Who last changed each digit of the frame, and the intensity after them.
+// Writes go out at the next commit, from the main loop, so that's who they're
+// put down to.
+static const char * _changeOrigin[DISPLAY_DIGITS + 1];
+static const char * _changeEvent[DISPLAY_DIGITS + 1];
+
+static unsigned long _regWrites[MAX_REGISTERS];
+static unsigned long _regRedundant[MAX_REGISTERS];
+static int _regValue[MAX72S19_CHIPS][MAX_REGISTERS];
+
+static unsigned long _writes;
+static unsigned long _redundant;
+
+static uint32_t _burstTick = UINT32_MAX;
+static unsigned _burstWrites;
+static unsigned _worstBurst;
+static uint32_t _worstBurstTick;
+static const char * _worstBurstEvent = "-";
+static unsigned long _burstHistogram[BURST_BUCKETS];
+
+static unsigned long _cyclesPerWrite = DEFAULT_CYCLES_PER_WRITE;
+static double _lastEndUs;
+
+static FILE * _log;
+static FILE * _vcd;
+
+NOINSTR static Counter * _counter(Counter * counters, unsigned * count,
+                                  unsigned max, const char * name) {
+  for (unsigned i = 0; i < *count; i++) {
+    if (counters[i].name == name) return &counters[i];
+  }
+
+  if (*count == max) return &counters[max - 1];
+
+  counters[*count].name = name;
+  return &counters[(*count)++];
+}
+
+NOINSTR static double _writeUs() {
+  return _cyclesPerWrite * 1e6 / F_CPU;
+}
+
+NOINSTR static void _closeBurst() {
+  unsigned bucket = _burstWrites < BURST_BUCKETS ? _burstWrites
+                                                  : BURST_BUCKETS - 1;
+
+  if (_burstTick != UINT32_MAX) _burstHistogram[bucket]++;
+}
+
+NOINSTR static void _vcdHeader() {
+  fprintf(_vcd,
+          "$timescale 1ns $end\n"
+          "$scope module max7219 $end\n"
+          "$var wire 1 c cs $end\n"
+          "$var wire 8 r reg [7:0] $end\n"
+          "$var wire 8 d data [7:0] $end\n"
+          "$var wire 1 x redundant $end\n"
+          "$upscope $end\n"
+          "$enddefinitions $end\n"
+          "#0\n1c\nb0 r\nb0 d\n0x\n");
+}
+
+NOINSTR static void _vcdBits(uint8_t value, char id) {
+  fputc('b', _vcd);
+  for (int bit = 7; bit >= 0; bit--) fputc(value & (1 << bit) ? '1' : '0', _vcd);
+  fprintf(_vcd, " %c\n", id);
+}
+
+// Innermost frame that isn't the driver, outermost one that isn't plumbing
+NOINSTR static void _caller(const char ** origin, const char ** event) {
+  *origin = "?";
+  *event = "(none)";
+
+  for (unsigned i = _depth; i-- > 0;) {
+    if (!_isDriver(_stack[i])) {
+      *origin = _stack[i];
+      break;
+    }
+  }
+
+  for (unsigned i = 0; i < _depth; i++) {
+    if (!_isPlumbing(_stack[i])) {
+      *event = _stack[i];
+      break;
+    }
+  }
+}
+
+NOINSTR static bool _inCommit() {
+  for (unsigned i = 0; i < _depth && i < MAX_DEPTH; i++) {
+    if (strcmp(_stack[i], "displayBackendCommit") == 0) return true;
+  }
+
+  return false;
+}
+
+void displayTraceChange(uint8_t digit) NOINSTR;
+
+void displayTraceChange(uint8_t digit) {
+  _caller(&_changeOrigin[digit], &_changeEvent[digit]);
+}
+
+void displayTraceWrite(uint8_t chip, uint8_t reg, uint8_t data) NOINSTR;
+
+void displayTraceWrite(uint8_t chip, uint8_t reg, uint8_t data) {
+  const char * origin;
+  const char * event;
+  uint32_t tick = simTicks();
+  bool redundant;
+  double startUs;
+
+  _caller(&origin, &event);
+
+  if (_inCommit()) {
+    int change = -1;
+
+    if (reg >= REG_DIGIT0 && reg <= REG_DIGIT7) {
+      change = chip * MAX_DIGITS + MAX72S19_REG_DIGIT(reg);
+    } else if (reg == REG_INTENSITY) {
+      change = DISPLAY_DIGITS;
+    }
+
+    if (change >= 0 && _changeOrigin[change] != NULL) {
+      origin = _changeOrigin[change];
+      event = _changeEvent[change];
+    }
+  }
+
+  reg &= MAX_REGISTERS - 1;
+  redundant = _regValue[chip][reg] == data;
+  _regValue[chip][reg] = data;
+
+  _writes++;
+  _regWrites[reg]++;
+
+  if (redundant) {
+    _redundant++;
+    _regRedundant[reg]++;
+  }
+
+  Counter * counters[] = {
+    _counter(_origins, &_originCount, MAX_NAMES, origin),
+    _counter(_events, &_eventCount, MAX_NAMES, event),
+    _phaseCount > 0 ? &_phases[_phaseCount - 1] : NULL
+  };
+
+  for (unsigned i = 0; i < sizeof(counters) / sizeof(counters[0]); i++) {
+    if (counters[i] == NULL) continue;
+    counters[i]->writes++;
+    if (redundant) counters[i]->redundant++;
+  }
+
+  if (tick != _burstTick) {
+    _closeBurst();
+    _burstTick = tick;
+    _burstWrites = 0;
+  }
+
+  if (++_burstWrites > _worstBurst) {
+    _worstBurst = _burstWrites;
+    _worstBurstTick = tick;
+    _worstBurstEvent = event;
+  }
+
+  // Writes in a tick go out back to back from the start of it. A burst that
+  // runs past the end of its tick pushes the next one back.
+  startUs = (double)tick * TICK_MS * 1000;
+  if (startUs < _lastEndUs) startUs = _lastEndUs;
+  _lastEndUs = startUs + _writeUs();
+
+  if (_log != NULL) {
+    fprintf(_log, "%.1f,%u,%u,0x%X,0x%02X,%d,%s,%s\n",
+            startUs, tick, chip, reg, data, redundant, origin, event);
+  }
+
+  if (_vcd != NULL) {
+    fprintf(_vcd, "#%llu\n0c\n", (unsigned long long)(startUs * 1000));
+    _vcdBits(reg, 'r');
+    _vcdBits(data, 'd');
+    fprintf(_vcd, "%dx\n$comment %s $end\n", redundant, origin);
+    fprintf(_vcd, "#%llu\n1c\n", (unsigned long long)(_lastEndUs * 1000));
+  }
+}
+
+void __cyg_profile_func_enter(void * fn, void * site) NOINSTR;
+void __cyg_profile_func_exit(void * fn, void * site) NOINSTR;
+
+void __cyg_profile_func_enter(void * fn, void * site) {
+  const char * name = _symbolName(fn);
+
+  if (_depth < MAX_DEPTH) _stack[_depth] = name;
+  _depth++;
+
+  _counter(_events, &_eventCount, MAX_NAMES, name)->calls++;
+}
+
+void __cyg_profile_func_exit(void * fn, void * site) {
+  if (_depth > 0) _depth--;
+}
+
+NOINSTR static void _onMark(const char * label) {
+  if (_phaseCount == MAX_PHASES) return;
+
+  // Phases aren't called, calls holds the tick they start at instead
+  _phases[_phaseCount].name = strdup(label);
+  _phases[_phaseCount].calls = simTicks();
+  _phaseCount++;
+}
+
+//------------------------------------------------------------------------------
+// Report
+//------------------------------------------------------------------------------
+
+NOINSTR static const char * _registerName(unsigned reg) {
+  static const char * names[MAX_REGISTERS] = {
+    "NOOP", "DIGIT0", "DIGIT1", "DIGIT2", "DIGIT3", "DIGIT4", "DIGIT5",
+    "DIGIT6", "DIGIT7", "DECODEMODE", "INTENSITY", "SCANLIMIT", "SHUTDOWN",
+    "0x0D", "0x0E", "DISPLAYTEST"
+  };
+
+  return names[reg];
+}
+
+NOINSTR static double _percent(unsigned long part, unsigned long whole) {
+  return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+NOINSTR static int _byWrites(const void * a, const void * b) {
+  unsigned long x = ((const Counter *)a)->writes;
+  unsigned long y = ((const Counter *)b)->writes;
+
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+NOINSTR static void _report() {
+  uint32_t ticks = simTicks();
+  double seconds = (double)ticks * TICK_MS / 1000;
+  double busyUs = _writes * _writeUs();
+
+  qsort(_origins, _originCount, sizeof(Counter), _byWrites);
+  qsort(_events, _eventCount, sizeof(Counter), _byWrites);
+
+  printf("Simulated %.1f s (%u ticks), %lu cycles per write (%.1f us)\n\n",
+         seconds, ticks, _cyclesPerWrite, _writeUs());
+
+  printf("Register writes     %10lu  %.1f per second\n",
+         _writes, seconds > 0 ? _writes / seconds : 0);
+  printf("Redundant writes    %10lu  %.1f%%\n",
+         _redundant, _percent(_redundant, _writes));
+  printf("Bus utilization     %10.3f%%\n",
+         seconds > 0 ? 100 * busyUs / (seconds * 1e6) : 0);
+  printf("Worst burst         %10u  writes in tick %u (%.0f us, %.0f%% of "
+         "the tick) from %s\n\n",
+         _worstBurst, _worstBurstTick, _worstBurst * _writeUs(),
+         100 * _worstBurst * _writeUs() / (TICK_MS * 1000), _worstBurstEvent);
+
+  printf("%-28s %10s %10s %10s %11s\n",
+         "Event", "calls", "writes", "redundant", "writes/call");
+  for (unsigned i = 0; i < _eventCount; i++) {
+    Counter * e = &_events[i];
+
+    if (e->writes == 0) continue;
+    printf("%-28s %10lu %10lu %10lu %11.1f\n", e->name, e->calls, e->writes,
+           e->redundant, e->calls > 0 ? (double)e->writes / e->calls : 0);
+  }
+
+  printf("\n%-28s %10s %10s %10s\n", "Origin", "", "writes", "redundant");
+  for (unsigned i = 0; i < _originCount; i++) {
+    printf("%-28s %10s %10lu %10lu\n", _origins[i].name, "",
+           _origins[i].writes, _origins[i].redundant);
+  }
+
+  printf("\n%-28s %10s %10s %10s\n", "Register", "", "writes", "redundant");
+  for (unsigned reg = 0; reg < MAX_REGISTERS; reg++) {
+    if (_regWrites[reg] == 0) continue;
+    printf("%-28s %10s %10lu %10lu\n", _registerName(reg), "",
+           _regWrites[reg], _regRedundant[reg]);
+  }
+
+  if (_phaseCount > 0) {
+    printf("\n%-28s %10s %10s %10s\n", "Phase", "seconds", "writes",
+           "redundant");
+    for (unsigned i = 0; i < _phaseCount; i++) {
+      uint32_t end = i + 1 < _phaseCount ? _phases[i + 1].calls : ticks;
+
+      printf("%-28s %10.1f %10lu %10lu\n", _phases[i].name,
+             (double)(end - _phases[i].calls) * TICK_MS / 1000,
+             _phases[i].writes, _phases[i].redundant);
+    }
+  }
+
+  printf("\nWrites per tick, ticks with any writes\n");
+  for (unsigned i = 1; i < BURST_BUCKETS; i++) {
+    if (_burstHistogram[i] == 0) continue;
+    printf("  %2u%s %10lu\n", i, i == BURST_BUCKETS - 1 ? "+" : " ",
+           _burstHistogram[i]);
+  }
+}
+
+NOINSTR static void _usage(const char * name) {
+  fprintf(stderr,
+          "Usage: %s [-c cycles] [-l log.csv] [-v trace.vcd] [scenario]\n",
+          name);
+}
+
+NOINSTR int main(int argc, char * argv[]) {
+  int opt;
+  bool ok;
+
+  while ((opt = getopt(argc, argv, "c:l:v:h")) != -1) {
+    switch (opt) {
+      case 'c':
+        _cyclesPerWrite = strtoul(optarg, NULL, 10);
+        break;
+      case 'l':
+        _log = fopen(optarg, "w");
+        if (_log == NULL) {
+          perror(optarg);
+          return 1;
+        }
+        fprintf(_log, "time_us,tick,chip,reg,value,redundant,origin,event\n");
+        break;
+      case 'v':
+        _vcd = fopen(optarg, "w");
+        if (_vcd == NULL) {
+          perror(optarg);
+          return 1;
+        }
+        _vcdHeader();
+        break;
+      default:
+        _usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind + 1 < argc || _cyclesPerWrite == 0) {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  _loadSymbols();
+  if (_symbolCount == 0) {
+    fprintf(stderr, "Couldn't read symbols, is nm installed?\n");
+  }
+
+  for (unsigned chip = 0; chip < MAX72S19_CHIPS; chip++) {
+    for (unsigned reg = 0; reg < MAX_REGISTERS; reg++) {
+      _regValue[chip][reg] = -1;
+    }
+  }
+
+  if (optind < argc) {
+    FILE * in = fopen(argv[optind], "r");
+
+    if (in == NULL) {
+      perror(argv[optind]);
+      return 1;
+    }
+
+    ok = scenarioRunFile(in, argv[optind], _onMark);
+    fclose(in);
+  } else {
+    ok = scenarioRunString(scenarioDefault, _onMark);
+  }
+
+  _closeBurst();
+
+  if (_log != NULL) fclose(_log);
+  if (_vcd != NULL) fclose(_vcd);
+  if (!ok) return 1;
+
+  _report();
+
+  return 0;
+}
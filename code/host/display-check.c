@@ -0,0 +1,111 @@
+// Display check.
+//
+// Runs the firmware in the host simulation (sim.h), with the display going
+// through the mock backend (display-mock.h), presses buttons the way a
+// scorekeeper would, and checks what the table shows after each step: the
+// startup animation, the scores as points are added and taken back, and
+// that each button event reaches the display in a single commit, with none
+// at all while nothing changes. Prints what failed, and exits non-zero if
+// anything did.
+//
+// Usage: display-check
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "sim.h"
+#include "display-mock.h"
+#include "../timing.h"
+
+// The scores, the table's lowest digits. The ones above are LEDs.
+#define SCORE_DIGITS 4
+
+#define PRESS_DOWN_MS 60
+#define PRESS_UP_MS   440
+#define LONG_DOWN_MS  2000
+#define LONG_UP_MS    500
+
+static unsigned _checks;
+static unsigned _failures;
+
+static void _wait(unsigned long ms) {
+  for (unsigned long ticks = TIMING_MS_TO_TICKS(ms); ticks > 0; ticks--) {
+    simTick();
+  }
+}
+
+// Commits it took
+static unsigned long _press(uint8_t button, bool isLong) {
+  unsigned long commits = displayMockCommits;
+
+  simSetButton(button, true);
+  _wait(isLong ? LONG_DOWN_MS : PRESS_DOWN_MS);
+  simSetButton(button, false);
+  _wait(isLong ? LONG_UP_MS : PRESS_UP_MS);
+
+  return displayMockCommits - commits;
+}
+
+static void _expectText(const char * step, const char * expected) {
+  char text[2 * SCORE_DIGITS + 1];
+
+  displayMockText(0, SCORE_DIGITS, text);
+  _checks++;
+  if (strcmp(text, expected) == 0) return;
+
+  _failures++;
+  printf("%s: shows \"%s\", expected \"%s\"\n", step, text, expected);
+}
+
+static void _expectCommits(const char * step, unsigned long commits,
+                           unsigned long expected) {
+  _checks++;
+  if (commits == expected) return;
+
+  _failures++;
+  printf("%s: %lu commits, expected %lu\n", step, commits, expected);
+}
+
+int main() {
+  unsigned long commits;
+
+  simPowerOn();
+  _wait(100);
+  // A g looks just like a 9, which the mock reads it as
+  _expectText("startup", "Pin9");
+  _wait(3000);
+  _expectText("after startup", " 0. 0");
+
+  // Player 1's score has the decimal point, and a blank tens digit under 10
+  _expectCommits("game start", _press(SIM_BTN_PLAYER1, false), 1);
+  _expectText("game start", " 0. 0");
+
+  for (uint8_t i = 0; i < 3; i++) {
+    _expectCommits("point", _press(SIM_BTN_PLAYER1, false), 1);
+  }
+  _expectText("points", " 3. 0");
+  _expectCommits("point", _press(SIM_BTN_PLAYER2, false), 1);
+  _expectText("points", " 3. 1");
+
+  commits = displayMockCommits;
+  _wait(5000);
+  _expectCommits("no input", displayMockCommits - commits, 0);
+
+  _expectCommits("undo", _press(SIM_BTN_PLAYER1, true), 1);
+  _expectText("undo", " 2. 1");
+
+  _expectCommits("undo", _press(SIM_BTN_PLAYER2, true), 1);
+  _expectText("undo", " 2. 0");
+
+  // Nothing to take back, nothing to redraw
+  _expectCommits("undo at 0", _press(SIM_BTN_PLAYER2, true), 0);
+  _expectText("undo at 0", " 2. 0");
+
+  for (uint8_t i = 0; i < 8; i++) _press(SIM_BTN_PLAYER1, false);
+  _expectText("two digits", "10. 0");
+
+  printf("%u checks, %u failed\n", _checks, _failures);
+  return _failures > 0;
+}
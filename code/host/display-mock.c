@@ -0,0 +1,56 @@
+// Display backend for host side tools, see display-mock.h
+
+#include <string.h>
+#include "display-mock.h"
+
+// Characters displayGlyph has a glyph for, tried in order, so of two with the
+// same segments ('5' and 'S') the first one wins
+#define GLYPH_CHARS "0123456789PingotSrbAuEGdFC"
+
+uint8_t displayMockFrame[DISPLAY_DIGITS];
+uint8_t displayMockIntensity;
+unsigned long displayMockCommits;
+
+// Takes the place of MAX72S19.c, pins and all
+#ifndef MAX72S19_FIXED_PINS
+void displaySetPins(uint8_t pinChipSelect, uint8_t pinDataOut,
+                    uint8_t pinClock) {
+}
+#endif
+
+void displayBackendSetup(uint8_t intensity) {
+  memset(displayMockFrame, 0, sizeof(displayMockFrame));
+  displayMockIntensity = intensity;
+}
+
+void displayBackendCommit(const uint8_t * frame, DisplayMask digits,
+                          uint8_t intensity, bool intensityChanged) {
+  for (uint8_t i = 0; i < DISPLAY_DIGITS; i++) {
+    if (!(digits & ((DisplayMask)1 << i))) continue;
+    displayMockFrame[i] = frame[i];
+  }
+
+  if (intensityChanged) displayMockIntensity = intensity;
+  displayMockCommits++;
+}
+
+// Nothing gets corrupted in memory
+void displayBackendScrub(const uint8_t * frame, uint8_t intensity) {
+}
+
+void displayMockText(uint8_t firstDigit, uint8_t digits, char * text) {
+  for (uint8_t i = firstDigit + digits; i-- > firstDigit;) {
+    uint8_t segments = i < DISPLAY_DIGITS ? displayMockFrame[i] : 0;
+    uint8_t glyph = segments & 0x7F;
+    char c = glyph == 0 ? ' ' : '?';
+
+    for (const char * g = GLYPH_CHARS; *g != '\0' && c == '?'; g++) {
+      if (displayGlyph(*g) == glyph) c = *g;
+    }
+
+    *text++ = c;
+    if (segments & 0x80) *text++ = '.';
+  }
+
+  *text = '\0';
+}
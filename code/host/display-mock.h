@@ -0,0 +1,24 @@
+#ifndef DISPLAY_MOCK_H_
+#define DISPLAY_MOCK_H_
+
+// Display backend that keeps what it's sent in memory rather than putting it
+// on a bus, for host side tools that want to know what the board shows. Link
+// display-mock.c in place of ../MAX72S19.c; the display keeps the shape the
+// MAX7219 gives it, see display.h.
+
+#include "../display.h"
+
+// As of the last commit
+extern uint8_t displayMockFrame[DISPLAY_DIGITS];
+extern uint8_t displayMockIntensity;
+
+// Commits so far. The display only commits when something changed.
+extern unsigned long displayMockCommits;
+
+// What the given digits show, from the highest (leftmost) down to the first,
+// as characters: a glyph's character, a space for a blank digit, '?' for
+// anything else, followed by a '.' if the decimal point is on. The buffer
+// takes up to two characters a digit, and the terminating '\0'.
+void displayMockText(uint8_t firstDigit, uint8_t digits, char * text);
+
+#endif // DISPLAY_MOCK_H_
@@ -0,0 +1,313 @@
+// Energy model.
+//
+// Runs the firmware in the host simulation (sim.h) through a scenario, then
+// leaves the board idle for a while, and adds up the current it would draw
+// tick by tick: the microcontroller at the clock it runs at, the MAX7219 for
+// the segments lit at the intensity set, and the buzzer while it sounds. From
+// that it estimates the charge a game takes, an hour of sitting idle, and a
+// day of both, and how much of it goes to each feature.
+//
+// Usage: energy-model [-i minutes] [-p hours] [-m mA] [-s mA] [-q mA]
+//                     [-b mA] [scenario]
+//
+//   -i minutes  idle time simulated after the scenario, 60 by default
+//   -p hours    hours of play in a day, for the daily estimate, 4 by default
+//   -m mA       microcontroller current at full clock (F_CPU, 5V), 9 by
+//               default. Scales down with the clock (timing.h), apart from
+//               MCU_STATIC_MA, which doesn't.
+//   -s mA       peak current through a segment, set by the MAX7219's RSET,
+//               40 by default
+//   -q mA       MAX7219 supply current with nothing lit, 8 by default
+//   -b mA       buzzer current while it sounds, 20 by default
+//   scenario    script as described in scenario.h, defaults to a built-in
+//               one covering a whole game
+//
+// The defaults are typical values, not measurements of a board: measure the
+// currents of yours and pass them in for numbers worth sizing a battery by.
+// The firmware never sleeps, the main loop polls, so the microcontroller is
+// always active, at full clock or at the idle clock. A MAX7219 drives one
+// digit at a time, so a lit segment draws its peak current for the
+// intensity's share of the time, (2 * intensity + 1) / 32, divided by the
+// digits scanned; indicator LEDs count as segments.
+//
+// The display goes through the mock backend (display-mock.h), so what's lit
+// is the frame as committed. animation.c and tonegen.c are compiled in here,
+// to tell from their state which animation and melody are running, and put
+// the current down to them.
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scenario.h"
+#include "sim.h"
+#include "display-mock.h"
+#include "../timing.h"
+#include "../animation.c"
+#include "../tonegen.c"
+
+#define MAX_PHASES 32
+
+// Microcontroller current that doesn't scale with the clock: the brown-out
+// detector, the watchdog, the oscillator itself
+#define MCU_STATIC_MA 0.3
+
+#define MAX7219_DUTY_STEPS 32
+
+#define MA_TICKS_TO_MAH(maTicks) ((maTicks) * TICK_MS / 3600000.0)
+
+// What the current is put down to
+typedef enum {
+  MCU_FULL,
+  MCU_IDLE,
+  DISPLAY_SUPPLY,
+  DISPLAY_GAME,
+  DISPLAY_STARTUP,
+  DISPLAY_WIN,
+  SOUND_STARTUP,
+  SOUND_WIN,
+  SOUND_PRESS,
+  SOUND_LONG_PRESS,
+  FEATURES
+} Feature;
+
+static const char * _featureNames[FEATURES] = {
+  "MCU at full clock",
+  "MCU at the idle clock",
+  "MAX7219 supply",
+  "Scores and LEDs",
+  "Startup fade",
+  "Win blinking",
+  "Startup melody",
+  "Win jingle",
+  "Click",
+  "Long press click",
+};
+
+// Current summed over the ticks it was drawn in, for play and for idle
+typedef struct {
+  double maTicks[2];
+  unsigned long ticks[2];
+} Usage;
+
+#define PLAY 0
+#define IDLE 1
+
+typedef struct {
+  const char * name;
+  uint32_t start; // Tick
+  double maTicks;
+} Phase;
+
+static double _mcuMa = 9;
+static double _segmentMa = 40;
+static double _supplyMa = 8;
+static double _buzzerMa = 20;
+
+static Usage _features[FEATURES];
+static double _maTicks[2];
+static uint8_t _part = PLAY;
+static double _peakMa;
+static unsigned _games;
+static bool _winShown;
+
+static Phase _phases[MAX_PHASES];
+static unsigned _phaseCount;
+
+static void _add(Feature feature, double ma) {
+  if (ma <= 0) return;
+  _features[feature].maTicks[_part] += ma;
+  _features[feature].ticks[_part]++;
+}
+
+static unsigned _litSegments(uint8_t digit) {
+  return __builtin_popcount(displayMockFrame[digit]);
+}
+
+static Feature _displayFeature() {
+  if (!taskIsRunning(&_task)) return DISPLAY_GAME;
+  return _playing == Startup ? DISPLAY_STARTUP : DISPLAY_WIN;
+}
+
+// The overlay player is the one heard while it plays, see tonegen.c
+static Feature _soundFeature() {
+  uint8_t melody = players[PLAYER_OVERLAY].melody != MELODY_NONE
+    ? players[PLAYER_OVERLAY].melody
+    : players[PLAYER_MAIN].melody;
+
+  switch (melody) {
+    case StartupMelo:        return SOUND_STARTUP;
+    case WinMelo:            return SOUND_WIN;
+    case ButtonLongPressSfx: return SOUND_LONG_PRESS;
+    default:                 return SOUND_PRESS;
+  }
+}
+
+static void _onTick() {
+  unsigned divider = 1u << (CLKPR & 0x0F);
+  double mcu = MCU_STATIC_MA + (_mcuMa - MCU_STATIC_MA) / divider;
+  double segment = _segmentMa * (2 * displayMockIntensity + 1)
+    / MAX7219_DUTY_STEPS / (MAX72S19_SCAN_LIMIT + 1);
+  double display = 0;
+  double buzzer = TCCR1A & 0x40 ? _buzzerMa : 0;
+  bool win = _displayFeature() == DISPLAY_WIN;
+
+  for (uint8_t i = 0; i < DISPLAY_DIGITS; i++) {
+    if (i % MAX_DIGITS > MAX72S19_SCAN_LIMIT) continue;
+    display += _litSegments(i) * segment;
+  }
+
+  _add(divider == 1 ? MCU_FULL : MCU_IDLE, mcu);
+  _add(DISPLAY_SUPPLY, _supplyMa);
+  _add(_displayFeature(), display);
+  if (buzzer > 0) _add(_soundFeature(), buzzer);
+
+  if (win && !_winShown) _games++;
+  _winShown = win;
+
+  double total = mcu + _supplyMa + display + buzzer;
+
+  _maTicks[_part] += total;
+  if (total > _peakMa) _peakMa = total;
+  if (_part == PLAY && _phaseCount > 0) {
+    _phases[_phaseCount - 1].maTicks += total;
+  }
+}
+
+static void _onMark(const char * label) {
+  if (_phaseCount == MAX_PHASES) return;
+
+  _phases[_phaseCount].name = strdup(label);
+  _phases[_phaseCount].start = simTicks();
+  _phaseCount++;
+}
+
+static double _percent(double part, double whole) {
+  return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+static int _byCharge(const void * a, const void * b) {
+  double x = _features[*(const Feature *)a].maTicks[PLAY];
+  double y = _features[*(const Feature *)b].maTicks[PLAY];
+
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void _report(uint32_t playTicks, uint32_t idleTicks, double playHours) {
+  double playMa = playTicks > 0 ? _maTicks[PLAY] / playTicks : 0;
+  double idleMa = idleTicks > 0 ? _maTicks[IDLE] / idleTicks : 0;
+  double idleHours = 24 - playHours;
+  Feature order[FEATURES];
+
+  printf("Simulated %.1f s of play (%u game%s), then %.1f min idle\n\n",
+         playTicks * TICK_MS / 1000.0, _games, _games == 1 ? "" : "s",
+         idleTicks * TICK_MS / 60000.0);
+
+  printf("Play                %10.2f mA average, %.2f mA peak\n",
+         playMa, _peakMa);
+  if (_games > 0) {
+    printf("Per game            %10.4f mAh\n",
+           MA_TICKS_TO_MAH(_maTicks[PLAY]) / _games);
+  }
+  printf("Idle                %10.2f mA average, %.2f mAh per hour\n",
+         idleMa, idleMa);
+  printf("Per day             %10.1f mAh, %.0f h of play and %.0f h idle\n\n",
+         playMa * playHours + idleMa * idleHours, playHours, idleHours);
+
+  for (unsigned i = 0; i < FEATURES; i++) order[i] = (Feature)i;
+  qsort(order, FEATURES, sizeof(Feature), _byCharge);
+
+  // Idle charge per hour is its average current
+  printf("%-24s %10s %10s %8s %10s %8s\n",
+         "Feature", "play s", "play mAh", "share", "idle mA", "share");
+  for (unsigned i = 0; i < FEATURES; i++) {
+    Usage * u = &_features[order[i]];
+
+    if (u->ticks[PLAY] == 0 && u->ticks[IDLE] == 0) continue;
+    printf("%-24s %10.1f %10.4f %7.1f%% %10.3f %7.1f%%\n",
+           _featureNames[order[i]], u->ticks[PLAY] * TICK_MS / 1000.0,
+           MA_TICKS_TO_MAH(u->maTicks[PLAY]),
+           _percent(u->maTicks[PLAY], _maTicks[PLAY]),
+           idleTicks > 0 ? u->maTicks[IDLE] / idleTicks : 0,
+           _percent(u->maTicks[IDLE], _maTicks[IDLE]));
+  }
+
+  if (_phaseCount > 0) {
+    printf("\n%-24s %10s %10s %10s\n", "Phase", "seconds", "mAh", "mA");
+    for (unsigned i = 0; i < _phaseCount; i++) {
+      uint32_t end = i + 1 < _phaseCount ? _phases[i + 1].start : playTicks;
+      uint32_t ticks = end - _phases[i].start;
+
+      printf("%-24s %10.1f %10.4f %10.2f\n", _phases[i].name,
+             ticks * TICK_MS / 1000.0, MA_TICKS_TO_MAH(_phases[i].maTicks),
+             ticks > 0 ? _phases[i].maTicks / ticks : 0);
+    }
+  }
+}
+
+static void _usage(const char * name) {
+  fprintf(stderr,
+          "Usage: %s [-i minutes] [-p hours] [-m mA] [-s mA] [-q mA] [-b mA] "
+          "[scenario]\n", name);
+}
+
+int main(int argc, char * argv[]) {
+  double idleMinutes = 60;
+  double playHours = 4;
+  uint32_t playTicks;
+  uint32_t idleTicks;
+  int opt;
+  bool ok;
+
+  while ((opt = getopt(argc, argv, "i:p:m:s:q:b:h")) != -1) {
+    switch (opt) {
+      case 'i': idleMinutes = atof(optarg); break;
+      case 'p': playHours = atof(optarg); break;
+      case 'm': _mcuMa = atof(optarg); break;
+      case 's': _segmentMa = atof(optarg); break;
+      case 'q': _supplyMa = atof(optarg); break;
+      case 'b': _buzzerMa = atof(optarg); break;
+      default:
+        _usage(argv[0]);
+        return 1;
+    }
+  }
+
+  if (optind + 1 < argc || idleMinutes < 0 || playHours < 0
+      || playHours > 24) {
+    _usage(argv[0]);
+    return 1;
+  }
+
+  simSetTickHook(_onTick);
+
+  if (optind < argc) {
+    FILE * in = fopen(argv[optind], "r");
+
+    if (in == NULL) {
+      perror(argv[optind]);
+      return 1;
+    }
+
+    ok = scenarioRunFile(in, argv[optind], _onMark);
+    fclose(in);
+  } else {
+    ok = scenarioRunString(scenarioDefault, _onMark);
+  }
+
+  if (!ok) return 1;
+
+  // Nobody touches it from here on
+  playTicks = simTicks();
+  for (int i = 0; i < SIM_BUTTONS; i++) simSetButton(i, false);
+  _part = IDLE;
+  idleTicks = (uint32_t)(idleMinutes * 60000 / TICK_MS);
+  for (uint32_t i = 0; i < idleTicks; i++) simTick();
+
+  _report(playTicks, idleTicks, playHours);
+
+  return 0;
+}
@@ -0,0 +1,25 @@
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+// EEPROM is an array in host/avr-stubs.c
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+extern uint8_t hostEeprom[];
+extern unsigned long hostEepromWrites;
+
+void hostEepromErase();
+
+uint8_t eeprom_read_byte(const uint8_t * addr);
+uint16_t eeprom_read_word(const uint16_t * addr);
+void eeprom_read_block(void * dst, const void * src, size_t n);
+void eeprom_write_byte(uint8_t * addr, uint8_t value);
+void eeprom_write_word(uint16_t * addr, uint16_t value);
+void eeprom_update_byte(uint8_t * addr, uint8_t value);
+void eeprom_update_word(uint16_t * addr, uint16_t value);
+void eeprom_update_block(const void * src, void * dst, size_t n);
+
+#endif // HOST_AVR_EEPROM_H_
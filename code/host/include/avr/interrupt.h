@@ -0,0 +1,11 @@
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+// Interrupt handlers become plain functions, named after their vector, that
+// host tools call to simulate the interrupt firing.
+#define ISR(vector, ...) void vector(void)
+
+#define sei()
+#define cli()
+
+#endif // HOST_AVR_INTERRUPT_H_
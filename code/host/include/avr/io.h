@@ -0,0 +1,90 @@
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+// Host stand-in for avr-libc's <avr/io.h>, so the firmware sources can be
+// compiled natively for the tools in host/. I/O registers are plain variables,
+// defined in host/avr-stubs.c. Only what the firmware uses is here.
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#define HOST_REG8(name) extern volatile uint8_t name;
+#define HOST_REG16(name) extern volatile uint16_t name;
+
+HOST_REG8(PORTA) HOST_REG8(DDRA) HOST_REG8(PINA)
+HOST_REG8(PORTB) HOST_REG8(DDRB) HOST_REG8(PINB)
+HOST_REG8(TCCR0A) HOST_REG8(TCCR0B) HOST_REG8(TCNT0)
+HOST_REG8(OCR0A) HOST_REG8(OCR0B) HOST_REG8(TIMSK0) HOST_REG8(TIFR0)
+HOST_REG8(TCCR1A) HOST_REG8(TCCR1B) HOST_REG8(TCCR1C)
+HOST_REG8(TIMSK1) HOST_REG8(TIFR1)
+HOST_REG16(TCNT1) HOST_REG16(OCR1A) HOST_REG16(OCR1B) HOST_REG16(ICR1)
+HOST_REG8(GIMSK) HOST_REG8(PCMSK0) HOST_REG8(PCMSK1)
+HOST_REG8(MCUSR) HOST_REG8(CLKPR) HOST_REG8(SREG)
+HOST_REG8(GPIOR0) HOST_REG8(GPIOR1) HOST_REG8(GPIOR2)
+HOST_REG8(USICR) HOST_REG8(USISR) HOST_REG8(USIDR)
+
+#define PINA0 0
+#define PINA1 1
+#define PINA2 2
+#define PINA3 3
+#define PINA4 4
+#define PINA5 5
+#define PINA6 6
+#define PINA7 7
+
+#define PINB0 0
+#define PINB1 1
+#define PINB2 2
+#define PINB3 3
+
+#define PORTA0 0
+#define PORTA1 1
+#define PORTA2 2
+#define PORTA3 3
+#define PORTA4 4
+#define PORTA5 5
+#define PORTA6 6
+#define PORTA7 7
+
+#define PCIE0  4
+#define PCINT0 0
+#define PCINT1 1
+#define PCINT2 2
+#define PCINT3 3
+
+#define PCIE1   5
+#define PCINT8  0
+#define PCINT9  1
+#define PCINT10 2
+
+#define PORF  0
+#define EXTRF 1
+#define BORF  2
+#define WDRF  3
+
+#define CLKPCE 7
+
+#define OCIE0A 1
+#define OCF0A  1
+#define OCIE0B 2
+#define TOIE1  0
+#define OCIE1A 1
+#define COM1A0 6
+#define COM1A1 7
+
+#define USIWM1 5
+#define USIWM0 4
+#define USICS1 3
+#define USICS0 2
+#define USICLK 1
+#define USITC  0
+#define USISIF 7
+#define USIOIF 6
+#define USIPF  5
+
+#define RAMSTART 0x60
+#define RAMEND   0x25F
+#define E2END    0x1FF
+
+#endif // HOST_AVR_IO_H_
@@ -0,0 +1,16 @@
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+// No separate program memory on the host
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr)  (*(void * const *)(addr))
+#define memcpy_P memcpy
+
+#endif // HOST_AVR_PGMSPACE_H_
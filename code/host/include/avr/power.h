@@ -0,0 +1,22 @@
+#ifndef HOST_AVR_POWER_H_
+#define HOST_AVR_POWER_H_
+
+#include <avr/io.h>
+
+typedef enum {
+  clock_div_1 = 0,
+  clock_div_2 = 1,
+  clock_div_4 = 2,
+  clock_div_8 = 3,
+  clock_div_16 = 4,
+  clock_div_32 = 5,
+  clock_div_64 = 6,
+  clock_div_128 = 7,
+  clock_div_256 = 8,
+} clock_div_t;
+
+// No timed sequence to get right on the host
+#define clock_prescale_set(x) (CLKPR = (x))
+#define clock_prescale_get() ((clock_div_t)(CLKPR & 0x0F))
+
+#endif // HOST_AVR_POWER_H_
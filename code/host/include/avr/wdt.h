@@ -0,0 +1,11 @@
+#ifndef HOST_AVR_WDT_H_
+#define HOST_AVR_WDT_H_
+
+#define WDTO_15MS 0
+#define WDTO_1S   6
+
+#define wdt_enable(timeout)
+#define wdt_disable()
+#define wdt_reset()
+
+#endif // HOST_AVR_WDT_H_
@@ -0,0 +1,9 @@
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+// Host tools simulate interrupts synchronously, nothing can interrupt a block
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (int _atomicOnce = 1; _atomicOnce; _atomicOnce = 0)
+
+#endif // HOST_UTIL_ATOMIC_H_
@@ -0,0 +1,7 @@
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+#define _delay_us(us)
+#define _delay_ms(ms)
+
+#endif // HOST_UTIL_DELAY_H_
@@ -0,0 +1,549 @@
+// Monte Carlo match simulator.
+//
+// Plays millions of games through the firmware's own scoring code, with
+// simulated players and a simulated scorekeeper pressing the buttons, and
+// reports how the games went: how long they were, how often they went to
+// deuce, how the serve was shared out, and what the scorekeeper's mistakes
+// did to the score. Meant for trying out rule changes in pingpong.c, and
+// checking that input mistakes can be recovered from, before they go on a
+// board.
+//
+// Usage: match-sim [-n games] [-j threads] [-s seed] [-p p1] [-e edge]
+//                  [-m mistakes] [-u undo] [-l long] [-c chords]
+//                  [-w points] [-r points]
+//
+//   -n games     games to play, one million by default
+//   -j threads   worker threads, one per core by default
+//   -s seed      random seed. Games are seeded by their number, so the
+//                results only depend on the seed, not on the threads.
+//   -p p1        chance player 1 wins a rally, 0.5 by default
+//   -e edge      added to the server's chance of winning a rally
+//   -m mistakes  chance the scorekeeper presses the loser's button instead
+//                of the winner's, per rally
+//   -u undo      chance a mistaken press is noticed and undone with a long
+//                press, then pressed right
+//   -l long      chance of an accidental long press on the winner's button,
+//                which takes a point off; the scorekeeper presses it again
+//                if the score went down
+//   -c chords    chance, per rally, that the players change ends and the
+//                scorekeeper swaps the sides with a two button chord
+//   -w points    points to win, as in the settings menu (settings.h)
+//   -r points    points between changes of serve, likewise
+//
+// pingpong.c is compiled in as is, and played through its public API with
+// the same buttons main.c would pass it, so everything goes through the real
+// transition table. Each game gets a context of its own (see pingpong.h), so
+// the threads share nothing but the display, animation, sound and task
+// scheduler, which are no-ops here. The serve is read with _getCurrentPlayer,
+// the same as the turn LEDs.
+//
+// Games are handed out in chunks over a work-stealing pool: each thread takes
+// chunks from the back of its own queue, and when that runs dry takes from
+// the front of another thread's.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../pingpong.c"
+
+#define CHUNK_GAMES       4096
+#define MAX_THREADS       256
+// A game that is still going after this many rallies is given up on, the
+// scorekeeper's mistakes can keep one going forever in theory
+#define MAX_RALLIES       400
+#define LENGTH_BUCKETS    64
+#define IMBALANCE_BUCKETS 8
+
+typedef struct {
+  unsigned long long games;
+  uint64_t seed;
+  double p1;
+  double edge;
+  double mistakes;
+  double undo;
+  double longPresses;
+  double chords;
+} Config;
+
+typedef struct {
+  unsigned long long games;
+  unsigned long long capped;
+  unsigned long long rallies;
+  unsigned long long length[LENGTH_BUCKETS]; // Rallies per game, from a win
+  unsigned long long deuces;
+  unsigned long long p1Wins;
+
+  // Serves by the player who served first, and by the other one
+  unsigned long long serves[2];
+  unsigned long long serverWins;
+  // Per game, how many more serves one player had than the other
+  unsigned long long imbalance[IMBALANCE_BUCKETS];
+
+  unsigned long long mistakes;
+  unsigned long long undone;
+  unsigned long long reversals; // Finished games an undo brought back
+  unsigned long long longPresses;
+  unsigned long long chords;
+  // Games where the board stopped showing what the scorekeeper meant to
+  // enter, other than through mistakes that weren't undone
+  unsigned long long corrupted;
+} Stats;
+
+typedef struct {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  // Chunks [top, bottom) are left to do. The owner takes from the bottom,
+  // thieves from the top.
+  unsigned long long top;
+  unsigned long long bottom;
+  unsigned long long steals;
+  unsigned id;
+  Stats stats;
+} Worker;
+
+static Config _config = {
+  .games = 1000000,
+  .seed = 1,
+  .p1 = 0.5,
+  .edge = 0.0,
+  .mistakes = 0.01,
+  .undo = 0.9,
+  .longPresses = 0.002,
+  .chords = 0.001,
+};
+
+static Worker _workers[MAX_THREADS];
+static unsigned _threads;
+
+//------------------------------------------------------------------------------
+// What pingpong.c drives besides the game, nothing to do for any of it here
+//------------------------------------------------------------------------------
+
+void displaySetLED(uint8_t row, uint8_t column, bool on) {}
+void displaySetRow(uint8_t row, uint8_t states) {}
+void displayWriteChar(uint8_t digitIndex, char character, bool dotOn) {}
+void displaySetIntensity(uint8_t intensity) {}
+void displayClear() {}
+void animationClear() {}
+void animationTrigger(Animations anim, void * context) {}
+void tonegenTriggerMelody(Melodies melody) {}
+
+// Nor for the task that saves all time scores: games never last long enough
+// for it, and the scheduler's lists are shared
+void taskStart(Task * task, taskFunction run) {}
+void taskStop(Task * task) {}
+void taskSignal(uint8_t events) {}
+void taskSleep(Task * task, uint16_t ticks) {}
+void taskWait(Task * task, uint8_t events) {}
+
+// Counters are for the board, not for a game
+void countersGameEnded() {}
+void countersGameUndone() {}
+void countersEepromWrite() {}
+void countersSave() {}
+
+//------------------------------------------------------------------------------
+// Random numbers, xorshift64*, seeded with splitmix64
+//------------------------------------------------------------------------------
+
+static uint64_t _seed(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+
+  return x != 0 ? x : 1;
+}
+
+static bool _chance(uint64_t * rng, double p) {
+  *rng ^= *rng >> 12;
+  *rng ^= *rng << 25;
+  *rng ^= *rng >> 27;
+
+  return ((*rng * 0x2545F4914F6CDD1DULL) >> 11) * 0x1.0p-53 < p;
+}
+
+//------------------------------------------------------------------------------
+// One game
+//------------------------------------------------------------------------------
+
+typedef struct {
+  PingpongContext ctx;
+  Button buttons[3];
+  // The players changed ends, player 1 is on the player 2 button
+  bool swapped;
+  // What the board should show for each player, by the scorekeeper's intent
+  uint8_t expected[2];
+  Stats * stats;
+} Game;
+
+// Maps a player to their button and back, depending on which end they're at
+static uint8_t _side(Game * g, uint8_t player) {
+  return g->swapped ? OTHER_PLAYER(player) : player;
+}
+
+static uint8_t _shown(Game * g, uint8_t player) {
+  return g->ctx.game.gameScores[_side(g, player) - 1];
+}
+
+static bool _isIntact(Game * g) {
+  return _shown(g, PINGPONG_PLAYER_1) == g->expected[0]
+    && _shown(g, PINGPONG_PLAYER_2) == g->expected[1];
+}
+
+static void _press(Game * g, uint8_t player) {
+  pingpongButtonPress(&g->ctx, &g->buttons[_side(g, player) - 1]);
+}
+
+static void _longPress(Game * g, uint8_t player) {
+  Button * button = &g->buttons[_side(g, player) - 1];
+  bool wasOver = g->ctx.game.state == PINGPONG_STATE_GAME_END;
+
+  button->held = true;
+  pingpongButtonLongPress(&g->ctx, button);
+  button->held = false;
+
+  if (wasOver && g->ctx.game.state != PINGPONG_STATE_GAME_END) {
+    g->stats->reversals++;
+  }
+}
+
+// Both player buttons held down. One of them always gets to long press first,
+// on its own, just like on the board.
+static void _chord(Game * g, uint64_t * rng) {
+  Button * first = &g->buttons[_chance(rng, 0.5) ? 0 : 1];
+  Button * second = first == &g->buttons[0] ? &g->buttons[1] : &g->buttons[0];
+
+  first->held = true;
+  pingpongButtonLongPress(&g->ctx, first);
+  second->held = true;
+  pingpongButtonLongPress(&g->ctx, second);
+  first->held = second->held = false;
+
+  g->swapped = !g->swapped;
+}
+
+// Enters a rally won by the given player, the way the scorekeeper does
+static void _score(Game * g, uint8_t winner, uint64_t * rng) {
+  Stats * stats = g->stats;
+  uint8_t loser = OTHER_PLAYER(winner);
+
+  if (_chance(rng, _config.mistakes)) {
+    stats->mistakes++;
+    _press(g, loser);
+
+    if (_chance(rng, _config.undo)) {
+      stats->undone++;
+      _longPress(g, loser);
+      _press(g, winner);
+      g->expected[winner - 1]++;
+    } else {
+      g->expected[loser - 1]++;
+    }
+
+    return;
+  }
+
+  if (_chance(rng, _config.longPresses)) {
+    uint8_t before = _shown(g, winner);
+
+    stats->longPresses++;
+    _longPress(g, winner);
+    if (_shown(g, winner) < before) _press(g, winner);
+  }
+
+  _press(g, winner);
+  g->expected[winner - 1]++;
+}
+
+static void _playGame(Stats * stats, uint64_t * rng) {
+  Game g;
+  PingpongGame * game = &g.ctx.game;
+  unsigned long long serves[2] = { 0, 0 };
+  unsigned rallies = 0;
+  uint8_t first;
+  bool deuce = false;
+  bool corrupted = false;
+
+  memset(&g, 0, sizeof(g));
+  g.stats = stats;
+
+  // Cold start: nothing to restore, EEPROM reads as zeroes. The startup
+  // animation would switch to the game display when it finishes.
+  pingpongInit(
+      &g.ctx, &g.buttons[0], &g.buttons[1], &g.buttons[2], 0, 0, false);
+  pingpongSetMode(&g.ctx, PINGPONG_DISPMODE_GAME);
+
+  // Whoever presses first serves first
+  first = _chance(rng, 0.5) ? PINGPONG_PLAYER_1 : PINGPONG_PLAYER_2;
+  _press(&g, first);
+
+  while (game->state != PINGPONG_STATE_GAME_END) {
+    uint8_t server;
+    uint8_t winner;
+    double p1;
+
+    if (++rallies > MAX_RALLIES) {
+      stats->capped++;
+      return;
+    }
+
+    server = _side(&g, _getCurrentPlayer(&g.ctx));
+    serves[server == first ? 0 : 1]++;
+
+    p1 = _config.p1
+      + (server == PINGPONG_PLAYER_1 ? _config.edge : -_config.edge);
+    winner = _chance(rng, p1) ? PINGPONG_PLAYER_1 : PINGPONG_PLAYER_2;
+    if (winner == server) stats->serverWins++;
+
+    _score(&g, winner, rng);
+
+    if (game->state == PINGPONG_STATE_GAME
+        && _chance(rng, _config.chords)) {
+      stats->chords++;
+      _chord(&g, rng);
+    }
+
+    if (!_isIntact(&g)) corrupted = true;
+
+    if (_shown(&g, PINGPONG_PLAYER_1) >= settings.pointsToWin - 1
+        && _shown(&g, PINGPONG_PLAYER_2) >= settings.pointsToWin - 1) {
+      deuce = true;
+    }
+  }
+
+  stats->games++;
+  stats->rallies += rallies;
+  stats->length[rallies < settings.pointsToWin
+    ? 0
+    : rallies - settings.pointsToWin < LENGTH_BUCKETS
+      ? rallies - settings.pointsToWin
+      : LENGTH_BUCKETS - 1]++;
+  if (deuce) stats->deuces++;
+  if (corrupted) stats->corrupted++;
+  if (_shown(&g, PINGPONG_PLAYER_1) > _shown(&g, PINGPONG_PLAYER_2)) {
+    stats->p1Wins++;
+  }
+
+  stats->serves[0] += serves[0];
+  stats->serves[1] += serves[1];
+  unsigned long long diff = serves[0] > serves[1]
+    ? serves[0] - serves[1]
+    : serves[1] - serves[0];
+  stats->imbalance[diff < IMBALANCE_BUCKETS ? diff : IMBALANCE_BUCKETS - 1]++;
+}
+
+static void _playChunk(Stats * stats, unsigned long long chunk) {
+  unsigned long long first = chunk * CHUNK_GAMES;
+  unsigned long long last = first + CHUNK_GAMES;
+
+  if (last > _config.games) last = _config.games;
+
+  for (unsigned long long i = first; i < last; i++) {
+    uint64_t rng = _seed(_config.seed * 0x100000001B3ULL ^ i);
+    _playGame(stats, &rng);
+  }
+}
+
+//------------------------------------------------------------------------------
+// Work-stealing pool
+//------------------------------------------------------------------------------
+
+static bool _takeOwn(Worker * w, unsigned long long * chunk) {
+  bool found = false;
+
+  pthread_mutex_lock(&w->lock);
+  if (w->top < w->bottom) {
+    *chunk = --w->bottom;
+    found = true;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return found;
+}
+
+static bool _steal(Worker * thief, unsigned long long * chunk) {
+  for (unsigned i = 1; i < _threads; i++) {
+    Worker * victim = &_workers[(thief->id + i) % _threads];
+    bool found = false;
+
+    pthread_mutex_lock(&victim->lock);
+    if (victim->top < victim->bottom) {
+      *chunk = victim->top++;
+      found = true;
+    }
+    pthread_mutex_unlock(&victim->lock);
+
+    if (found) {
+      thief->steals++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void * _work(void * arg) {
+  Worker * w = arg;
+  unsigned long long chunk;
+
+  // No work is ever added, so once nobody has any left we're done
+  while (_takeOwn(w, &chunk) || _steal(w, &chunk)) {
+    _playChunk(&w->stats, chunk);
+  }
+
+  return NULL;
+}
+
+static void _merge(Stats * total, const Stats * s) {
+  const unsigned long long * from = (const unsigned long long *)s;
+  unsigned long long * to = (unsigned long long *)total;
+
+  // All counters, the same type throughout
+  for (size_t i = 0; i < sizeof(Stats) / sizeof(*to); i++) to[i] += from[i];
+}
+
+//------------------------------------------------------------------------------
+// Report
+//------------------------------------------------------------------------------
+
+static double _pct(unsigned long long n, unsigned long long of) {
+  return of == 0 ? 0.0 : 100.0 * n / of;
+}
+
+static unsigned _percentile(const Stats * s, double p) {
+  unsigned long long target = (unsigned long long)(s->games * p);
+  unsigned long long seen = 0;
+
+  for (unsigned i = 0; i < LENGTH_BUCKETS; i++) {
+    seen += s->length[i];
+    if (seen > target) return i + settings.pointsToWin;
+  }
+
+  return LENGTH_BUCKETS - 1 + settings.pointsToWin;
+}
+
+static void _report(const Stats * s) {
+  unsigned long long steals = 0;
+  unsigned long long serves = s->serves[0] + s->serves[1];
+
+  for (unsigned i = 0; i < _threads; i++) steals += _workers[i].steals;
+
+  printf("Played %llu games on %u threads, %llu chunks stolen\n\n",
+      s->games, _threads, steals);
+
+  printf("Rallies per game    %10.2f  median %u, 90%% %u, 99%% %u\n",
+      s->games ? (double)s->rallies / s->games : 0.0,
+      _percentile(s, 0.5), _percentile(s, 0.9), _percentile(s, 0.99));
+  printf("Deuce               %10.2f%%\n", _pct(s->deuces, s->games));
+  printf("Won by player 1     %10.2f%%\n", _pct(s->p1Wins, s->games));
+  if (s->capped > 0) {
+    printf("Given up on         %10llu  after %u rallies\n",
+        s->capped, MAX_RALLIES);
+  }
+
+  printf("\nServes by first server %7.2f%%\n", _pct(s->serves[0], serves));
+  printf("Rallies won by server  %7.2f%%\n", _pct(s->serverWins, serves));
+  printf("Serve difference per game\n");
+  for (unsigned i = 0; i < IMBALANCE_BUCKETS; i++) {
+    printf("  %2u%s %10llu  %6.2f%%\n", i,
+        i == IMBALANCE_BUCKETS - 1 ? "+" : " ",
+        s->imbalance[i], _pct(s->imbalance[i], s->games));
+  }
+
+  printf("\nMistaken presses    %10llu  %llu undone\n",
+      s->mistakes, s->undone);
+  printf("Finished games reversed %6llu  %.3f%% of games\n",
+      s->reversals, _pct(s->reversals, s->games));
+  printf("Stray long presses  %10llu\n", s->longPresses);
+  printf("Side swap chords    %10llu\n", s->chords);
+  printf("Corrupted games     %10llu  %.3f%%, board differs from what was "
+      "entered\n", s->corrupted, _pct(s->corrupted, s->games));
+
+  printf("\nRallies per game, games\n");
+  for (unsigned i = 0; i < LENGTH_BUCKETS; i++) {
+    if (s->length[i] == 0) continue;
+    printf("  %3u%s %10llu  %6.2f%%\n", i + settings.pointsToWin,
+        i == LENGTH_BUCKETS - 1 ? "+" : " ",
+        s->length[i], _pct(s->length[i], s->games));
+  }
+}
+
+static void _usage(const char * name) {
+  fprintf(stderr,
+      "Usage: %s [-n games] [-j threads] [-s seed] [-p p1] [-e edge]\n"
+      "       %*s [-m mistakes] [-u undo] [-l long] [-c chords]\n"
+      "       %*s [-w points] [-r points]\n",
+      name, (int)strlen(name), "", (int)strlen(name), "");
+}
+
+int main(int argc, char ** argv) {
+  unsigned long long chunks;
+  Stats total;
+  long cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+
+  _threads = cores > 0 ? (unsigned)cores : 1;
+  settingsDefaults();
+
+  while ((opt = getopt(argc, argv, "n:j:s:p:e:m:u:l:c:w:r:")) != -1) {
+    switch (opt) {
+      case 'n': _config.games = strtoull(optarg, NULL, 10); break;
+      case 'j': _threads = strtoul(optarg, NULL, 10); break;
+      case 's': _config.seed = strtoull(optarg, NULL, 10); break;
+      case 'p': _config.p1 = strtod(optarg, NULL); break;
+      case 'e': _config.edge = strtod(optarg, NULL); break;
+      case 'm': _config.mistakes = strtod(optarg, NULL); break;
+      case 'u': _config.undo = strtod(optarg, NULL); break;
+      case 'l': _config.longPresses = strtod(optarg, NULL); break;
+      case 'c': _config.chords = strtod(optarg, NULL); break;
+      case 'w': settings.pointsToWin = atoi(optarg); break;
+      case 'r': settings.pointsToChangeServe = atoi(optarg); break;
+      default:
+        _usage(argv[0]);
+        return 2;
+    }
+  }
+
+  if (optind != argc || _threads == 0 || settings.pointsToWin == 0
+      || settings.pointsToChangeServe == 0) {
+    _usage(argv[0]);
+    return 2;
+  }
+
+  if (_threads > MAX_THREADS) _threads = MAX_THREADS;
+
+  // Each thread starts out with an even share of the chunks
+  chunks = (_config.games + CHUNK_GAMES - 1) / CHUNK_GAMES;
+  for (unsigned i = 0; i < _threads; i++) {
+    Worker * w = &_workers[i];
+
+    w->id = i;
+    w->top = chunks * i / _threads;
+    w->bottom = chunks * (i + 1) / _threads;
+    pthread_mutex_init(&w->lock, NULL);
+  }
+
+  for (unsigned i = 0; i < _threads; i++) {
+    if (pthread_create(&_workers[i].thread, NULL, _work, &_workers[i]) != 0) {
+      fprintf(stderr, "Couldn't start thread %u\n", i);
+      return 1;
+    }
+  }
+
+  memset(&total, 0, sizeof(total));
+  for (unsigned i = 0; i < _threads; i++) {
+    pthread_join(_workers[i].thread, NULL);
+    _merge(&total, &_workers[i].stats);
+  }
+
+  _report(&total);
+
+  return 0;
+}
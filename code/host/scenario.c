@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "scenario.h"
+#include "sim.h"
+#include "../timing.h"
+
+#define PRESS_DOWN_MS 60
+#define PRESS_UP_MS   440
+#define LONG_DOWN_MS  2000
+#define LONG_UP_MS    500
+
+const char * scenarioDefault =
+  "# Startup animation and melody\n"
+  "wait 2000\n"
+  "mark game\n"
+  "press p1\n"                 // p1 serves first
+  "repeat 5 press p1\n"
+  "repeat 3 press p2\n"
+  "repeat 4 press p1\n"
+  "press p2\n"
+  "long p2\n"                  // undo a point
+  "repeat 2 press p1\n"        // 11 - 3
+  "wait 4000\n"                // win animation
+  "mark modes\n"
+  "repeat 3 press mode\n"
+  "mark swap\n"
+  "press p1\n"                 // new game
+  "repeat 3 press p2\n"
+  "chord\n"
+  "mark idle\n"
+  "wait 31000\n";              // scores get saved
+
+static void _wait(unsigned long ms) {
+  for (unsigned long ticks = TIMING_MS_TO_TICKS(ms); ticks > 0; ticks--) {
+    simTick();
+  }
+}
+
+static int _button(const char * name) {
+  if (name == NULL) return -1;
+  if (strcmp(name, "p1") == 0) return SIM_BTN_PLAYER1;
+  if (strcmp(name, "p2") == 0) return SIM_BTN_PLAYER2;
+  if (strcmp(name, "mode") == 0) return SIM_BTN_MODE;
+  return -1;
+}
+
+// Runs one command, tokenised in place. Returns false if it isn't valid.
+static bool _runCommand(char * cmd, char * rest, ScenarioMarkFn onMark) {
+  char * arg = strtok(rest, " \t");
+  int button = _button(arg);
+
+  if (strcmp(cmd, "wait") == 0) {
+    if (arg == NULL) return false;
+    _wait(strtoul(arg, NULL, 10));
+    return true;
+  }
+
+  if (strcmp(cmd, "press") == 0 || strcmp(cmd, "long") == 0) {
+    bool isLong = cmd[0] == 'l';
+
+    if (button < 0) return false;
+    simSetButton(button, true);
+    _wait(isLong ? LONG_DOWN_MS : PRESS_DOWN_MS);
+    simSetButton(button, false);
+    _wait(isLong ? LONG_UP_MS : PRESS_UP_MS);
+    return true;
+  }
+
+  if (strcmp(cmd, "chord") == 0) {
+    simSetButton(SIM_BTN_PLAYER1, true);
+    simSetButton(SIM_BTN_PLAYER2, true);
+    _wait(LONG_DOWN_MS);
+    simSetButton(SIM_BTN_PLAYER1, false);
+    simSetButton(SIM_BTN_PLAYER2, false);
+    _wait(LONG_UP_MS);
+    return true;
+  }
+
+  if (strcmp(cmd, "down") == 0 || strcmp(cmd, "up") == 0) {
+    if (button < 0) return false;
+    simSetButton(button, cmd[0] == 'd');
+    return true;
+  }
+
+  if (strcmp(cmd, "repeat") == 0) {
+    char * repeated;
+    char * repeatedRest;
+    char buffer[128];
+    unsigned long times;
+
+    if (arg == NULL) return false;
+    times = strtoul(arg, NULL, 10);
+    repeatedRest = strtok(NULL, "");
+    if (repeatedRest == NULL) return false;
+
+    for (unsigned long i = 0; i < times; i++) {
+      // Tokenising is destructive, work on a copy each time
+      snprintf(buffer, sizeof(buffer), "%s", repeatedRest);
+      repeated = strtok(buffer, " \t");
+      if (repeated == NULL) return false;
+      if (!_runCommand(repeated, strtok(NULL, ""), onMark)) return false;
+    }
+
+    return true;
+  }
+
+  if (strcmp(cmd, "mark") == 0) {
+    if (arg == NULL) return false;
+    if (onMark != NULL) onMark(arg);
+    return true;
+  }
+
+  return false;
+}
+
+static bool _runLine(char * line, const char * name, unsigned lineNumber,
+                     ScenarioMarkFn onMark) {
+  char * cmd;
+  char * comment = strchr(line, '#');
+
+  if (comment != NULL) *comment = '\0';
+  line[strcspn(line, "\r\n")] = '\0';
+
+  cmd = strtok(line, " \t");
+  if (cmd == NULL) return true;
+
+  if (!_runCommand(cmd, strtok(NULL, ""), onMark)) {
+    fprintf(stderr, "%s:%u: invalid command\n", name, lineNumber);
+    return false;
+  }
+
+  return true;
+}
+
+bool scenarioRunFile(FILE * in, const char * name, ScenarioMarkFn onMark) {
+  char line[256];
+  unsigned lineNumber = 0;
+
+  simPowerOn();
+
+  while (fgets(line, sizeof(line), in) != NULL) {
+    if (!_runLine(line, name, ++lineNumber, onMark)) return false;
+  }
+
+  return true;
+}
+
+bool scenarioRunString(const char * script, ScenarioMarkFn onMark) {
+  FILE * in = fmemopen((void *)script, strlen(script), "r");
+  bool ok;
+
+  if (in == NULL) return false;
+  ok = scenarioRunFile(in, "<built-in>", onMark);
+  fclose(in);
+
+  return ok;
+}
@@ -0,0 +1,31 @@
+#ifndef SCENARIO_H_
+#define SCENARIO_H_
+
+// Scripted input for the simulation in sim.h. One command per line, # starts
+// a comment, times are in milliseconds:
+//
+//   wait <ms>                 let time pass
+//   press <p1|p2|mode>        short press: down 60 ms, then up 440 ms
+//   long <p1|p2|mode>         long press: down 2000 ms, then up 500 ms
+//   chord                     p1 and p2 held down together for 2000 ms
+//   down <p1|p2|mode>         raw button edges
+//   up <p1|p2|mode>
+//   repeat <n> <command>      runs a single command n times
+//   mark <label>              passed to the mark callback, e.g. to delimit
+//                             games in reports
+//
+// The board is powered on before the first command.
+
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef void (*ScenarioMarkFn)(const char * label);
+
+bool scenarioRunFile(FILE * in, const char * name, ScenarioMarkFn onMark);
+bool scenarioRunString(const char * script, ScenarioMarkFn onMark);
+
+// A bit of everything: startup, a full game with a win, the display modes,
+// swapping sides, and sitting idle long enough for scores to be saved.
+extern const char * scenarioDefault;
+
+#endif // SCENARIO_H_
@@ -0,0 +1,57 @@
+// Pulls in main.c as is, so the simulation runs exactly what the board runs.
+// main() is renamed out of the way, and the attributes that only make sense
+// for the startup code on an AVR are neutralised.
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "sim.h"
+
+#define main firmwareMain
+#define naked noinline
+#include "../main.c"
+#undef main
+#undef naked
+
+static const uint8_t _buttonPins[SIM_BUTTONS] = {
+  PIN_BTN_PLAYER1, PIN_BTN_PLAYER2, PIN_BTN_MODE
+};
+
+static uint32_t _simTicks;
+static SimTickFn _tickHook;
+
+void simPowerOn() {
+  // Buttons are pulled up, so idle high
+  PINA = 0xFF;
+  PINB = 0xFF;
+  MCUSR = _BV(PORF);
+  _simTicks = 0;
+
+  _saveResetCause();
+  _setup();
+}
+
+void simTick() {
+  _simTicks++;
+  TIM0_COMPA_vect();
+  _loop();
+  if (_tickHook != NULL) _tickHook();
+}
+
+void simSetTickHook(SimTickFn hook) {
+  _tickHook = hook;
+}
+
+void simSetButton(uint8_t button, bool down) {
+  uint8_t mask = _BV(_buttonPins[button]);
+  uint8_t pins = down ? (PINA & ~mask) : (PINA | mask);
+
+  if (pins == PINA) return;
+
+  PINA = pins;
+  PCINT0_vect();
+  _loop();
+}
+
+uint32_t simTicks() {
+  return _simTicks;
+}
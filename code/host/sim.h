@@ -0,0 +1,35 @@
+#ifndef SIM_H_
+#define SIM_H_
+
+// Runs the real firmware on the host: main.c and the modules it uses,
+// compiled natively against the stand-ins in host/include. Time only moves
+// when simTick is called; buttons are driven through their pins and the pin
+// change interrupt, like on the board.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_BTN_PLAYER1 0
+#define SIM_BTN_PLAYER2 1
+#define SIM_BTN_MODE    2
+#define SIM_BUTTONS     3
+
+// Powers the board up: runs the firmware's setup, as after a power-on reset.
+// EEPROM keeps its contents; it starts out all zeroes, like a scoreboard that
+// has been reset, use hostEepromErase for a factory fresh chip.
+void simPowerOn();
+
+// One timer interrupt and the main loop iteration that handles it
+void simTick();
+
+// Called at the end of every simTick, for tools that follow the state of the
+// board over time. NULL for none.
+typedef void (*SimTickFn)();
+void simSetTickHook(SimTickFn);
+
+void simSetButton(uint8_t button, bool down);
+
+// Ticks since simPowerOn
+uint32_t simTicks();
+
+#endif // SIM_H_
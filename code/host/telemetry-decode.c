@@ -0,0 +1,233 @@
+// Decodes the telemetry stream of a scoreboard built with TELEMETRY=1.
+//
+// Usage: telemetry-decode [-j] [-b baud] <device>
+//
+// <device> is a serial port (e.g. /dev/ttyUSB0) connected to PA0, a pty, or
+// a file. Use - for stdin. Serial ports and ptys are put in raw mode at the
+// given baud rate, 9600 by default, to match TELEMETRY_BAUD.
+//
+// Prints one line per event, as plain text or with -j as JSON, for feeding
+// into other tools. Corrupt frames are skipped, and the decoder resyncs on the
+// next sync byte.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "../telemetry.h"
+
+static int _json;
+
+static speed_t _baudToSpeed(long baud) {
+  switch (baud) {
+    case 1200:   return B1200;
+    case 2400:   return B2400;
+    case 4800:   return B4800;
+    case 9600:   return B9600;
+    case 19200:  return B19200;
+    case 38400:  return B38400;
+    case 57600:  return B57600;
+    case 115200: return B115200;
+    default:     return 0;
+  }
+}
+
+static int _setupTty(int fd, long baud) {
+  struct termios tio;
+  speed_t speed = _baudToSpeed(baud);
+
+  // Not a tty (regular file, pipe): nothing to configure
+  if (!isatty(fd)) return 0;
+
+  if (speed == 0) {
+    fprintf(stderr, "Unsupported baud rate %ld\n", baud);
+    return -1;
+  }
+
+  if (tcgetattr(fd, &tio) < 0) return -1;
+
+  cfmakeraw(&tio);
+  tio.c_cflag |= CLOCAL | CREAD;
+  tio.c_cflag &= ~(CSTOPB | PARENB);
+  tio.c_cc[VMIN] = 1;
+  tio.c_cc[VTIME] = 0;
+  cfsetispeed(&tio, speed);
+  cfsetospeed(&tio, speed);
+
+  return tcsetattr(fd, TCSANOW, &tio);
+}
+
+static const char * _typeName(uint8_t type) {
+  switch (type) {
+    case TELEMETRY_EVT_BOOT:     return "boot";
+    case TELEMETRY_EVT_POINT:    return "point";
+    case TELEMETRY_EVT_UNDO:     return "undo";
+    case TELEMETRY_EVT_GAME_END: return "game_end";
+    case TELEMETRY_EVT_MODE:     return "mode";
+    case TELEMETRY_EVT_OVERRUN:  return "overrun";
+    case TELEMETRY_EVT_SAVE:     return "save";
+    case TELEMETRY_EVT_STACK:    return "stack";
+    default:                     return "unknown";
+  }
+}
+
+static void _printEvent(const uint8_t * frame) {
+  struct timeval now;
+  uint8_t type = frame[1];
+  uint8_t a = frame[2];
+  uint8_t b = frame[3];
+  uint8_t c = frame[4];
+  char fields[96];
+
+  gettimeofday(&now, NULL);
+
+  switch (type) {
+    case TELEMETRY_EVT_BOOT:
+      snprintf(fields, sizeof(fields),
+          _json ? "\"mcusr\":%u,\"restored\":%u" : "mcusr=0x%02x restored=%u",
+          a, b);
+      break;
+
+    case TELEMETRY_EVT_POINT:
+    case TELEMETRY_EVT_UNDO:
+      snprintf(fields, sizeof(fields),
+          _json ? "\"player\":%u,\"p1\":%u,\"p2\":%u" : "player=%u p1=%u p2=%u",
+          a, b, c);
+      break;
+
+    case TELEMETRY_EVT_GAME_END:
+      snprintf(fields, sizeof(fields),
+          _json
+            ? "\"winner\":%u,\"set_p1\":%u,\"set_p2\":%u"
+            : "winner=%u set_p1=%u set_p2=%u",
+          a, b, c);
+      break;
+
+    case TELEMETRY_EVT_MODE:
+      snprintf(fields, sizeof(fields), _json ? "\"mode\":%u" : "mode=%u", a);
+      break;
+
+    case TELEMETRY_EVT_OVERRUN:
+      snprintf(fields, sizeof(fields),
+          _json
+            ? "\"overruns\":%u,\"dropped\":%u,\"behind\":%u"
+            : "overruns=%u dropped=%u behind=%u",
+          a, b, c);
+      break;
+
+    case TELEMETRY_EVT_SAVE:
+      snprintf(fields, sizeof(fields),
+          _json ? "\"all_p1\":%u,\"all_p2\":%u" : "all_p1=%u all_p2=%u",
+          a, b);
+      break;
+
+    case TELEMETRY_EVT_STACK:
+      snprintf(fields, sizeof(fields),
+          _json ? "\"min_free\":%u,\"fault\":%u" : "min_free=%u fault=%u",
+          a | (b << 8), c);
+      break;
+
+    default:
+      snprintf(fields, sizeof(fields),
+          _json
+            ? "\"type\":%u,\"a\":%u,\"b\":%u,\"c\":%u"
+            : "type=0x%02x a=%u b=%u c=%u",
+          type, a, b, c);
+      break;
+  }
+
+  if (_json) {
+    printf("{\"time\":%ld.%03ld,\"event\":\"%s\",%s}\n",
+        (long)now.tv_sec, (long)now.tv_usec / 1000, _typeName(type), fields);
+  } else {
+    printf("%ld.%03ld %s %s\n",
+        (long)now.tv_sec, (long)now.tv_usec / 1000, _typeName(type), fields);
+  }
+
+  fflush(stdout);
+}
+
+int main(int argc, char ** argv) {
+  long baud = 9600;
+  const char * path;
+  int fd;
+  int opt;
+  uint8_t frame[TELEMETRY_FRAME_SIZE];
+  size_t filled = 0;
+  unsigned long badFrames = 0;
+
+  while ((opt = getopt(argc, argv, "jb:")) != -1) {
+    switch (opt) {
+      case 'j': _json = 1; break;
+      case 'b': baud = strtol(optarg, NULL, 10); break;
+      default:
+        fprintf(stderr, "Usage: %s [-j] [-b baud] <device>\n", argv[0]);
+        return 2;
+    }
+  }
+
+  if (optind >= argc) {
+    fprintf(stderr, "Usage: %s [-j] [-b baud] <device>\n", argv[0]);
+    return 2;
+  }
+
+  path = argv[optind];
+  fd = strcmp(path, "-") == 0 ? STDIN_FILENO : open(path, O_RDONLY | O_NOCTTY);
+
+  if (fd < 0) {
+    fprintf(stderr, "Can't open %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  if (_setupTty(fd, baud) < 0) {
+    fprintf(stderr, "Can't configure %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  for (;;) {
+    uint8_t byte;
+    ssize_t n = read(fd, &byte, 1);
+
+    if (n == 0) break;
+
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      fprintf(stderr, "Read error: %s\n", strerror(errno));
+      return 1;
+    }
+
+    // Wait for a sync byte to start a frame
+    if (filled == 0 && byte != TELEMETRY_SYNC) continue;
+
+    frame[filled++] = byte;
+    if (filled < TELEMETRY_FRAME_SIZE) continue;
+
+    if (frame[5] == TELEMETRY_CHECKSUM(frame[1], frame[2], frame[3], frame[4])) {
+      _printEvent(frame);
+      filled = 0;
+      continue;
+    }
+
+    // Corrupt, or we synced on a data byte that happened to look like a sync
+    // byte. Look for the next sync byte within what we already have.
+    badFrames++;
+    size_t next;
+    for (next = 1; next < TELEMETRY_FRAME_SIZE; next++) {
+      if (frame[next] == TELEMETRY_SYNC) break;
+    }
+
+    filled = TELEMETRY_FRAME_SIZE - next;
+    memmove(frame, frame + next, filled);
+  }
+
+  if (badFrames > 0) fprintf(stderr, "%lu corrupt frames skipped\n", badFrames);
+
+  return 0;
+}
@@ -0,0 +1,944 @@
+// Static worst case execution time estimator.
+//
+// Reads the firmware's disassembly (avr-objdump -d main.elf) and works out
+// an upper bound on the cycles each function can take, by summing instruction
+// cycle counts along the longest path through it, callees included. Unlike a
+// measurement, that covers paths no test happens to exercise. The roots given
+// on the command line are checked against a cycle budget, and every interrupt
+// handler (__vector_N) is checked against an interrupt latency budget.
+//
+// Usage: wcet [-a annotations] [-f hz] [-l cycles] [-p vector=cycles]...
+//             root=cycles... < disassembly
+//
+//   -a file         loop bounds and indirect call targets, see below
+//   -f hz           CPU clock, to show microseconds alongside cycles
+//   -l cycles       longest any interrupt may wait to be serviced
+//   -p vector=cycles  an interrupt that fires at most every so many cycles,
+//                   its handler's time is added to the roots it can preempt
+//   root=cycles     a function and the cycles it has to finish in
+//
+// Exits non-zero if a budget is exceeded, or if the bound isn't complete: a
+// loop or an indirect call without an annotation, recursion, loops that
+// aren't nested.
+//
+// Loops come from backward jumps: a backward jump or branch closes a loop
+// from its target to itself. Each loop is counted as (bound + 1) times the
+// longest way round it, the extra round covering the way in and the way
+// out, then the longest exit. Conditional branches cost their taken cycles
+// on the taken edge only, skips their skipped cycles on the skipping edge.
+//
+// Annotations, one per line, # starts a comment:
+//
+//   loop <function> <bound>...   How many times the loops in the function go
+//                                round, per call. Bounds are given to loops in
+//                                address order, the last one is used for any
+//                                loops left over.
+//   calls <function> <target>... Functions an icall in the function can call.
+//                                "*" gives targets for every function that
+//                                has none of its own.
+//
+// An ijmp without annotation, as used for switch jump tables, is taken to go
+// to any instruction after it in the same function. Interrupt latency is the
+// longest handler or stretch of code with interrupts off (cli to sei or a
+// write to SREG), plus the response time, one of them at a time.
+
+#include <ctype.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_FUNCTIONS 512
+#define MAX_BOUNDS    8
+#define MAX_TARGETS   32
+#define MAX_ROOTS     8
+#define MAX_PERIODIC  4
+#define MAX_EDGES     (MAX_TARGETS + 2)
+
+// An interrupt takes 4 cycles to respond, plus the rjmp in the vector table.
+// Whatever instruction is running finishes first, up to 4 cycles.
+#define INTERRUPT_RESPONSE 6
+#define LONGEST_INSTRUCTION 4
+
+// Cycles of the __tablejump2__ helper, from the jump to it to its ijmp
+#define TABLEJUMP_CYCLES 12
+
+#define SINK -1
+#define NONE INT64_MIN
+
+enum {
+  KIND_PLAIN,
+  KIND_BRANCH,
+  KIND_SKIP,
+  KIND_JUMP,
+  KIND_CALL,
+  KIND_ICALL,
+  KIND_IJMP,
+  KIND_RETURN,
+};
+
+typedef struct {
+  uint32_t address;
+  uint8_t size;
+  uint8_t kind;
+  uint8_t cycles; // Branch not taken, skip not skipping
+  int64_t target; // Jumps, branches and calls, -1 if none
+  bool interruptsOff; // cli
+  bool interruptsOn; // sei, out to SREG, or a return
+} Instruction;
+
+typedef struct {
+  int head;
+  int end;
+  uint32_t bound;
+} Loop;
+
+typedef struct {
+  char name[64];
+  uint32_t address;
+  int first; // In _instructions
+  int count;
+  uint8_t state; // 0 to do, 1 in progress, 2 done
+  bool reachable;
+  int64_t wcet;
+  int64_t * distance; // Longest path from each instruction to the return
+  Loop * loops;
+  int loopCount;
+  uint32_t bounds[MAX_BOUNDS];
+  int boundCount;
+  int targets[MAX_TARGETS]; // Function indexes, for icall
+  int targetCount;
+  bool hasTargets;
+} Function;
+
+typedef struct {
+  int64_t cost;
+  int64_t address; // SINK when the edge leaves through a return
+} Edge;
+
+typedef struct {
+  int function;
+  int64_t budget;
+} Root;
+
+typedef struct {
+  int function;
+  int64_t period;
+} Periodic;
+
+static Instruction * _instructions;
+static int _instructionCount;
+static int _instructionSpace;
+
+static Function _functions[MAX_FUNCTIONS];
+static int _functionCount;
+
+// Targets for icalls in functions without their own, from "calls *"
+static char _anyTargets[MAX_TARGETS][64];
+static int _anyTargetCount;
+
+static int _errors;
+
+//------------------------------------------------------------------------------
+// Disassembly
+//------------------------------------------------------------------------------
+
+typedef struct {
+  const char * mnemonic;
+  uint8_t kind;
+  uint8_t cycles;
+} Opcode;
+
+// Everything not listed is a single cycle ALU or I/O instruction. Cycles as
+// in the ATtiny84 datasheet's instruction set summary.
+static const Opcode _opcodes[] = {
+  { "adiw", KIND_PLAIN, 2 },  { "sbiw", KIND_PLAIN, 2 },
+  { "ld", KIND_PLAIN, 2 },    { "ldd", KIND_PLAIN, 2 },
+  { "lds", KIND_PLAIN, 2 },   { "st", KIND_PLAIN, 2 },
+  { "std", KIND_PLAIN, 2 },   { "sts", KIND_PLAIN, 2 },
+  { "push", KIND_PLAIN, 2 },  { "pop", KIND_PLAIN, 2 },
+  { "sbi", KIND_PLAIN, 2 },   { "cbi", KIND_PLAIN, 2 },
+  { "lpm", KIND_PLAIN, 3 },   { "elpm", KIND_PLAIN, 3 },
+  { "spm", KIND_PLAIN, 4 },   { "mul", KIND_PLAIN, 2 },
+  { "muls", KIND_PLAIN, 2 },  { "mulsu", KIND_PLAIN, 2 },
+  { "fmul", KIND_PLAIN, 2 },  { "fmuls", KIND_PLAIN, 2 },
+  { "fmulsu", KIND_PLAIN, 2 },
+  { "cpse", KIND_SKIP, 1 },   { "sbrc", KIND_SKIP, 1 },
+  { "sbrs", KIND_SKIP, 1 },   { "sbic", KIND_SKIP, 1 },
+  { "sbis", KIND_SKIP, 1 },
+  { "rjmp", KIND_JUMP, 2 },   { "jmp", KIND_JUMP, 3 },
+  { "rcall", KIND_CALL, 3 },  { "call", KIND_CALL, 4 },
+  { "icall", KIND_ICALL, 3 }, { "ijmp", KIND_IJMP, 2 },
+  { "ret", KIND_RETURN, 4 },  { "reti", KIND_RETURN, 4 },
+};
+
+static void _addInstruction(Instruction * instruction) {
+  if (_instructionCount == _instructionSpace) {
+    _instructionSpace = _instructionSpace ? _instructionSpace * 2 : 1024;
+    _instructions = realloc(
+        _instructions, _instructionSpace * sizeof(Instruction));
+    if (!_instructions) {
+      fprintf(stderr, "Out of memory\n");
+      exit(2);
+    }
+  }
+
+  _instructions[_instructionCount++] = *instruction;
+}
+
+// "  a4:\t0f 93       \tpush\tr16" and the like. Targets of jumps, branches
+// and calls are in the comment objdump adds: "; 0x1a8 <_shiftOut>".
+static bool _parseInstruction(char * line, Instruction * instruction) {
+  char * fields[5] = { 0 };
+  char * comment;
+  unsigned address;
+  int count = 0;
+
+  if (sscanf(line, " %x:", &address) != 1 || !strchr(line, '\t')) {
+    return false;
+  }
+
+  for (char * field = strtok(line, "\t\n"); field && count < 5;
+       field = strtok(NULL, "\t\n")) {
+    fields[count++] = field;
+  }
+  if (count < 3) return false;
+
+  memset(instruction, 0, sizeof(Instruction));
+  instruction->address = address;
+  instruction->kind = KIND_PLAIN;
+  instruction->cycles = 1;
+  instruction->target = -1;
+
+  // Two hex digits and a space per byte
+  for (char * c = fields[1]; *c; c++) {
+    if (*c != ' ' && (c[1] == ' ' || c[1] == '\0')) instruction->size++;
+  }
+
+  for (size_t i = 0; i < sizeof(_opcodes) / sizeof(Opcode); i++) {
+    if (strcmp(fields[2], _opcodes[i].mnemonic) == 0) {
+      instruction->kind = _opcodes[i].kind;
+      instruction->cycles = _opcodes[i].cycles;
+      break;
+    }
+  }
+
+  if (strncmp(fields[2], "br", 2) == 0 && strcmp(fields[2], "break") != 0) {
+    instruction->kind = KIND_BRANCH;
+  }
+
+  instruction->interruptsOff = strcmp(fields[2], "cli") == 0;
+  instruction->interruptsOn = strcmp(fields[2], "sei") == 0
+    || instruction->kind == KIND_RETURN
+    || (strcmp(fields[2], "out") == 0 && fields[3]
+        && strncmp(fields[3], "0x3f,", 5) == 0);
+
+  comment = NULL;
+  for (int i = 3; i < count; i++) {
+    if ((comment = strstr(fields[i], "; 0x"))) break;
+  }
+
+  if (comment) {
+    instruction->target = strtoll(comment + 2, NULL, 16);
+  } else if (fields[3] && instruction->kind >= KIND_BRANCH
+             && instruction->kind <= KIND_CALL) {
+    instruction->target = strtoll(fields[3], NULL, 0);
+  }
+
+  return true;
+}
+
+static void _readDisassembly(FILE * in) {
+  char line[512];
+  char name[64];
+  unsigned address;
+  Instruction instruction;
+  Function * function = NULL;
+
+  while (fgets(line, sizeof(line), in)) {
+    if (sscanf(line, "%x <%63[^>]>:", &address, name) == 2) {
+      if (_functionCount == MAX_FUNCTIONS) {
+        fprintf(stderr, "Too many functions, raise MAX_FUNCTIONS\n");
+        exit(2);
+      }
+      function = &_functions[_functionCount++];
+      memset(function, 0, sizeof(Function));
+      strcpy(function->name, name);
+      function->address = address;
+      function->first = _instructionCount;
+      continue;
+    }
+
+    if (function && _parseInstruction(line, &instruction)) {
+      _addInstruction(&instruction);
+      function->count++;
+    }
+  }
+}
+
+static bool _isHandler(Function * f) {
+  return strncmp(f->name, "__vector_", 9) == 0 && isdigit(f->name[9]);
+}
+
+static int _findFunction(const char * name) {
+  for (int i = 0; i < _functionCount; i++) {
+    if (strcmp(_functions[i].name, name) == 0) return i;
+  }
+
+  return -1;
+}
+
+// The function an address is in, -1 if none
+static int _functionAt(int64_t address) {
+  for (int i = 0; i < _functionCount; i++) {
+    Function * f = &_functions[i];
+
+    if (f->count == 0 || address < f->address) continue;
+    if (address <= _instructions[f->first + f->count - 1].address) return i;
+  }
+
+  return -1;
+}
+
+// Index within the function, -1 if it isn't one of its instructions
+static int _indexOf(Function * f, int64_t address) {
+  int low = 0;
+  int high = f->count - 1;
+
+  while (low <= high) {
+    int middle = (low + high) / 2;
+    uint32_t here = _instructions[f->first + middle].address;
+
+    if (here == address) return middle;
+    if (here < address) {
+      low = middle + 1;
+    } else {
+      high = middle - 1;
+    }
+  }
+
+  return -1;
+}
+
+//------------------------------------------------------------------------------
+// Annotations
+//------------------------------------------------------------------------------
+
+// Names that aren't in this build's disassembly are skipped, one annotation
+// file serves every build.
+static void _readAnnotations(const char * path) {
+  char line[512];
+  FILE * in = fopen(path, "r");
+  int number = 0;
+
+  if (!in) {
+    perror(path);
+    exit(2);
+  }
+
+  while (fgets(line, sizeof(line), in)) {
+    char * hash = strchr(line, '#');
+    char * keyword;
+    char * name;
+    char * word;
+    int index;
+
+    number++;
+    if (hash) *hash = '\0';
+
+    keyword = strtok(line, " \t\n");
+    if (!keyword) continue;
+
+    name = strtok(NULL, " \t\n");
+    if (!name) {
+      fprintf(stderr, "%s:%d: no function\n", path, number);
+      exit(2);
+    }
+
+    if (strcmp(keyword, "calls") == 0 && strcmp(name, "*") == 0) {
+      while ((word = strtok(NULL, " \t\n"))
+             && _anyTargetCount < MAX_TARGETS) {
+        snprintf(_anyTargets[_anyTargetCount++], 64, "%s", word);
+      }
+      continue;
+    }
+
+    index = _findFunction(name);
+
+    if (strcmp(keyword, "loop") == 0) {
+      while ((word = strtok(NULL, " \t\n"))) {
+        if (index < 0) continue;
+        if (_functions[index].boundCount < MAX_BOUNDS) {
+          _functions[index].bounds[_functions[index].boundCount++] =
+            strtoul(word, NULL, 0);
+        }
+      }
+    } else if (strcmp(keyword, "calls") == 0) {
+      if (index >= 0) _functions[index].hasTargets = true;
+      while ((word = strtok(NULL, " \t\n"))) {
+        int target = _findFunction(word);
+
+        if (index < 0 || target < 0) continue;
+        if (_functions[index].targetCount < MAX_TARGETS) {
+          _functions[index].targets[_functions[index].targetCount++] = target;
+        }
+      }
+    } else {
+      fprintf(stderr, "%s:%d: unknown annotation %s\n", path, number,
+          keyword);
+      exit(2);
+    }
+  }
+
+  fclose(in);
+
+  // Whatever "calls *" names, for every function without its own
+  for (int i = 0; i < _functionCount; i++) {
+    if (_functions[i].hasTargets) continue;
+    for (int t = 0; t < _anyTargetCount; t++) {
+      int target = _findFunction(_anyTargets[t]);
+
+      if (target >= 0) _functions[i].targets[_functions[i].targetCount++] =
+        target;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Longest paths
+//------------------------------------------------------------------------------
+
+static void _analyze(int index);
+
+static int64_t _max(int64_t a, int64_t b) {
+  return a > b ? a : b;
+}
+
+// Longest path from an address to the return of the function it's in
+static int64_t _distanceFrom(int64_t address) {
+  int index = _functionAt(address);
+  int at;
+
+  if (index < 0) {
+    fprintf(stderr, "error: jump to 0x%" PRIx64 ", outside any function\n",
+        address);
+    _errors++;
+    return 0;
+  }
+
+  _analyze(index);
+  at = _indexOf(&_functions[index], address);
+
+  return at < 0 ? _functions[index].wcet : _functions[index].distance[at];
+}
+
+// Where an instruction can go next, and what getting there costs, callees
+// included
+static int _edges(Function * f, int i, Edge * edges) {
+  Instruction * in = &_instructions[f->first + i];
+  int64_t next = in->address + in->size;
+  int count = 0;
+
+  switch (in->kind) {
+    case KIND_BRANCH:
+      edges[count++] = (Edge){ 1, next };
+      edges[count++] = (Edge){ 2, in->target };
+      break;
+
+    case KIND_SKIP: {
+      uint8_t skipped = i + 1 < f->count
+        ? _instructions[f->first + i + 1].size : 2;
+
+      edges[count++] = (Edge){ 1, next };
+      edges[count++] = (Edge){ 1 + skipped / 2, next + skipped };
+      break;
+    }
+
+    case KIND_JUMP:
+      if (_functionAt(in->target) >= 0
+          && strncmp(_functions[_functionAt(in->target)].name,
+                     "__tablejump", 11) == 0) {
+        // Into a switch's jump table, somewhere further on
+        for (int j = i + 1; j < f->count && count < MAX_EDGES; j++) {
+          edges[count++] = (Edge){
+            in->cycles + TABLEJUMP_CYCLES, _instructions[f->first + j].address
+          };
+        }
+        break;
+      }
+      edges[count++] = (Edge){ in->cycles, in->target };
+      break;
+
+    case KIND_CALL:
+      edges[count++] = (Edge){
+        in->cycles + _distanceFrom(in->target), next
+      };
+      break;
+
+    case KIND_ICALL: {
+      int64_t longest = 0;
+
+      for (int t = 0; t < f->targetCount; t++) {
+        _analyze(f->targets[t]);
+        longest = _max(longest, _functions[f->targets[t]].wcet);
+      }
+      edges[count++] = (Edge){ in->cycles + longest, next };
+      break;
+    }
+
+    case KIND_IJMP:
+      if (f->targetCount > 0 && f->hasTargets) {
+        for (int t = 0; t < f->targetCount; t++) {
+          edges[count++] = (Edge){
+            in->cycles, _functions[f->targets[t]].address
+          };
+        }
+        break;
+      }
+      for (int j = i + 1; j < f->count && count < MAX_EDGES; j++) {
+        edges[count++] = (Edge){
+          in->cycles, _instructions[f->first + j].address
+        };
+      }
+      if (count == 0) edges[count++] = (Edge){ in->cycles, SINK };
+      break;
+
+    case KIND_RETURN:
+      edges[count++] = (Edge){ in->cycles, SINK };
+      break;
+
+    default:
+      edges[count++] = (Edge){ in->cycles, next };
+      break;
+  }
+
+  return count;
+}
+
+// What reaching an address is worth from within a region: a loop from head
+// to end, or the whole function when head is -1. Leaving a loop, going round
+// it, or returning ends the path there. Leaving the function carries on in
+// whatever code is jumped to.
+static int64_t _value(Function * f, int lo, int hi, int head, int64_t address) {
+  int j;
+
+  if (address == SINK) return 0;
+
+  j = _indexOf(f, address);
+  if (j < 0 || j < lo || j > hi) {
+    return head >= 0 ? 0 : _distanceFrom(address);
+  }
+  if (j == head) return 0;
+
+  return f->distance[j];
+}
+
+// The outermost loop strictly inside the region that ends at i
+static Loop * _loopEndingAt(Function * f, int i, int lo, int hi, int head) {
+  for (int l = 0; l < f->loopCount; l++) {
+    Loop * loop = &f->loops[l];
+
+    if (loop->end != i || loop->head < lo) continue;
+    if (head >= 0 && loop->head == lo && loop->end == hi) continue;
+
+    return loop;
+  }
+
+  return NULL;
+}
+
+// Fills in distance for every instruction of the region, backwards, since
+// apart from going round a loop every edge goes forwards. Loops inside it
+// are worked out first, and every instruction in one gets the whole loop's
+// cost. Returns the longest way through the region: round it for a loop,
+// from the top to the return for the function.
+static int64_t _solve(Function * f, int lo, int hi, int head) {
+  int64_t longest = 0;
+  Edge edges[MAX_EDGES];
+
+  for (int i = hi; i >= lo; i--) {
+    Loop * loop = _loopEndingAt(f, i, lo, hi, head);
+    int64_t cost;
+
+    if (loop) {
+      int64_t exits = 0;
+
+      cost = _solve(f, loop->head, loop->end, loop->head)
+        * (loop->bound + 1);
+
+      for (int k = loop->head; k <= loop->end; k++) {
+        int count = _edges(f, k, edges);
+
+        for (int e = 0; e < count; e++) {
+          int j = edges[e].address == SINK
+            ? -1 : _indexOf(f, edges[e].address);
+
+          if (j >= loop->head && j <= loop->end) continue;
+          exits = _max(exits, _value(f, lo, hi, head, edges[e].address));
+        }
+      }
+
+      cost += exits;
+      for (int k = loop->head; k <= loop->end; k++) f->distance[k] = cost;
+      longest = _max(longest, cost);
+      i = loop->head;
+      continue;
+    }
+
+    cost = NONE;
+    for (int e = 0, count = _edges(f, i, edges); e < count; e++) {
+      cost = _max(cost,
+          edges[e].cost + _value(f, lo, hi, head, edges[e].address));
+    }
+
+    f->distance[i] = cost;
+    longest = _max(longest, cost);
+  }
+
+  return head >= 0 ? longest : f->distance[lo];
+}
+
+static int _compareLoops(const void * a, const void * b) {
+  const Loop * x = a;
+  const Loop * y = b;
+
+  if (x->head != y->head) return x->head - y->head;
+  return y->end - x->end;
+}
+
+// One loop per backward jump target, closed by the last jump back to it.
+// Loops that overlap without nesting are merged into one.
+static void _findLoops(Function * f) {
+  Edge edges[MAX_EDGES];
+
+  f->loops = calloc(f->count, sizeof(Loop));
+
+  for (int i = 0; i < f->count; i++) {
+    int count = _edges(f, i, edges);
+
+    for (int e = 0; e < count; e++) {
+      int j = edges[e].address == SINK ? -1 : _indexOf(f, edges[e].address);
+      int l;
+
+      if (j < 0 || j > i) continue;
+
+      for (l = 0; l < f->loopCount && f->loops[l].head != j; l++) {}
+      if (l == f->loopCount) f->loops[f->loopCount++] = (Loop){ j, i, 0 };
+      if (f->loops[l].end < i) f->loops[l].end = i;
+    }
+  }
+
+  qsort(f->loops, f->loopCount, sizeof(Loop), _compareLoops);
+
+  for (int l = 0; l + 1 < f->loopCount; l++) {
+    Loop * outer = &f->loops[l];
+    Loop * inner = &f->loops[l + 1];
+
+    if (inner->head > outer->end || inner->end <= outer->end) continue;
+
+    fprintf(stderr, "error: loops at 0x%x and 0x%x in %s overlap\n",
+        _instructions[f->first + outer->head].address,
+        _instructions[f->first + inner->head].address, f->name);
+    _errors++;
+    outer->end = inner->end;
+    memmove(inner, inner + 1, (f->loopCount - l - 2) * sizeof(Loop));
+    f->loopCount--;
+    l = -1;
+  }
+
+  for (int l = 0; l < f->loopCount; l++) {
+    if (f->boundCount == 0) {
+      fprintf(stderr, "error: loop at 0x%x in %s, no loop annotation\n",
+          _instructions[f->first + f->loops[l].head].address, f->name);
+      _errors++;
+      f->loops[l].bound = 1;
+      continue;
+    }
+    f->loops[l].bound =
+      f->bounds[l < f->boundCount ? l : f->boundCount - 1];
+  }
+}
+
+static void _analyze(int index) {
+  Function * f = &_functions[index];
+
+  if (f->state == 2) return;
+  if (f->state == 1) {
+    fprintf(stderr, "error: %s is recursive\n", f->name);
+    _errors++;
+    return;
+  }
+
+  f->state = 1;
+  f->distance = calloc(f->count ? f->count : 1, sizeof(int64_t));
+
+  for (int i = 0; i < f->count; i++) {
+    Instruction * in = &_instructions[f->first + i];
+
+    if (in->kind != KIND_ICALL || f->targetCount > 0) continue;
+    fprintf(stderr, "error: icall at 0x%x in %s, no calls annotation\n",
+        in->address, f->name);
+    _errors++;
+  }
+
+  _findLoops(f);
+  f->wcet = f->count ? _solve(f, 0, f->count - 1, -1) : 0;
+  f->state = 2;
+}
+
+//------------------------------------------------------------------------------
+// Reachability and interrupts
+//------------------------------------------------------------------------------
+
+static void _markReachable(int index) {
+  Function * f = &_functions[index];
+
+  if (f->reachable) return;
+  f->reachable = true;
+
+  for (int i = 0; i < f->count; i++) {
+    Instruction * in = &_instructions[f->first + i];
+    int target = in->target >= 0 ? _functionAt(in->target) : -1;
+
+    if (target >= 0 && target != index) _markReachable(target);
+    if (in->kind == KIND_ICALL) {
+      for (int t = 0; t < f->targetCount; t++) _markReachable(f->targets[t]);
+    }
+  }
+}
+
+// Longest way from a cli to turning interrupts back on, -1 if there's a loop
+// or a jump elsewhere on the way
+static int64_t _interruptsOff(Function * f, int i, int64_t * memo) {
+  Edge edges[MAX_EDGES];
+  Instruction * in = &_instructions[f->first + i];
+  int64_t longest = 0;
+
+  if (memo[i]) return memo[i];
+  if (in->interruptsOn) return memo[i] = in->cycles;
+
+  for (int e = 0, count = _edges(f, i, edges); e < count; e++) {
+    int j = edges[e].address == SINK ? -1 : _indexOf(f, edges[e].address);
+
+    if (j <= i) {
+      fprintf(stderr,
+          "error: interrupts off at 0x%x in %s, and no way to tell how long\n",
+          in->address, f->name);
+      _errors++;
+      continue;
+    }
+    longest = _max(longest, edges[e].cost + _interruptsOff(f, j, memo));
+  }
+
+  return memo[i] = longest;
+}
+
+static int64_t _longestInterruptsOff(int * where) {
+  int64_t longest = 0;
+
+  for (int index = 0; index < _functionCount; index++) {
+    Function * f = &_functions[index];
+    int64_t * memo;
+
+    if (!f->reachable || _isHandler(f)) continue;
+
+    memo = calloc(f->count ? f->count : 1, sizeof(int64_t));
+    for (int i = 0; i < f->count; i++) {
+      int64_t cycles;
+
+      if (!_instructions[f->first + i].interruptsOff) continue;
+      cycles = _interruptsOff(f, i, memo);
+      if (cycles > longest) {
+        longest = cycles;
+        *where = index;
+      }
+    }
+    free(memo);
+  }
+
+  return longest;
+}
+
+//------------------------------------------------------------------------------
+// Report
+//------------------------------------------------------------------------------
+
+static long _clock;
+
+static void _printCycles(int64_t cycles) {
+  printf("%8" PRId64, cycles);
+  if (_clock) printf("  %9.1f us", cycles * 1e6 / _clock);
+}
+
+static int _compareWcet(const void * a, const void * b) {
+  int64_t x = _functions[*(const int *)a].wcet;
+  int64_t y = _functions[*(const int *)b].wcet;
+
+  return x < y ? 1 : x > y ? -1 : 0;
+}
+
+// Response time: the root, plus every periodic interrupt that can fire while
+// it runs, until that stops growing or goes over budget
+static int64_t _responseTime(Root * root, Periodic * periodic, int count) {
+  int64_t own = _functions[root->function].wcet;
+  int64_t total = own;
+  int64_t previous = -1;
+
+  while (total != previous && total <= root->budget) {
+    previous = total;
+    total = own;
+    for (int p = 0; p < count; p++) {
+      int64_t handler = _functions[periodic[p].function].wcet
+        + INTERRUPT_RESPONSE;
+
+      total += (previous + periodic[p].period - 1) / periodic[p].period
+        * handler;
+    }
+  }
+
+  return total;
+}
+
+static void _usage(const char * name) {
+  fprintf(stderr,
+      "Usage: %s [-a annotations] [-f hz] [-l cycles] "
+      "[-p vector=cycles]... root=cycles... < disassembly\n", name);
+  exit(2);
+}
+
+int main(int argc, char ** argv) {
+  Root roots[MAX_ROOTS];
+  Periodic periodic[MAX_PERIODIC];
+  int rootCount = 0;
+  int periodicCount = 0;
+  const char * annotations = NULL;
+  char * periodicArgs[MAX_PERIODIC];
+  int periodicArgCount = 0;
+  int64_t latency = 0;
+  int64_t longestHandler = 0;
+  int64_t longestOff;
+  int handler = -1;
+  int offIn = -1;
+  int order[MAX_FUNCTIONS];
+  int listed = 0;
+  bool failed = false;
+  int option;
+
+  while ((option = getopt(argc, argv, "a:f:l:p:")) != -1) {
+    switch (option) {
+      case 'a': annotations = optarg; break;
+      case 'f': _clock = strtol(optarg, NULL, 0); break;
+      case 'l': latency = strtoll(optarg, NULL, 0); break;
+      case 'p':
+        if (periodicArgCount == MAX_PERIODIC) _usage(argv[0]);
+        periodicArgs[periodicArgCount++] = optarg;
+        break;
+      default: _usage(argv[0]);
+    }
+  }
+
+  _readDisassembly(stdin);
+  if (_functionCount == 0) {
+    fprintf(stderr, "No disassembly on stdin\n");
+    return 2;
+  }
+  if (annotations) _readAnnotations(annotations);
+
+  for (int i = optind; i < argc; i++) {
+    char * equals = strchr(argv[i], '=');
+
+    if (!equals || rootCount == MAX_ROOTS) _usage(argv[0]);
+    *equals = '\0';
+    roots[rootCount].function = _findFunction(argv[i]);
+    roots[rootCount].budget = strtoll(equals + 1, NULL, 0);
+    if (roots[rootCount].function < 0) {
+      fprintf(stderr, "No function %s in the disassembly\n", argv[i]);
+      return 2;
+    }
+    rootCount++;
+  }
+
+  // Interrupts not in this build are left out
+  for (int p = 0; p < periodicArgCount; p++) {
+    char * equals = strchr(periodicArgs[p], '=');
+    int index;
+
+    if (!equals) _usage(argv[0]);
+    *equals = '\0';
+    index = _findFunction(periodicArgs[p]);
+    if (index < 0) continue;
+    periodic[periodicCount++] =
+      (Periodic){ index, strtoll(equals + 1, NULL, 0) };
+  }
+
+  for (int r = 0; r < rootCount; r++) _markReachable(roots[r].function);
+  for (int i = 0; i < _functionCount; i++) {
+    if (_isHandler(&_functions[i])) _markReachable(i);
+  }
+
+  for (int i = 0; i < _functionCount; i++) {
+    if (!_functions[i].reachable) continue;
+    _analyze(i);
+    order[listed++] = i;
+  }
+
+  // Interrupts off in the main loop too, not just under the roots
+  if (_findFunction("main") >= 0) _markReachable(_findFunction("main"));
+  longestOff = _longestInterruptsOff(&offIn);
+
+  qsort(order, listed, sizeof(int), _compareWcet);
+
+  printf("Worst case cycles%s, callees included:\n\n",
+      _clock ? " and time" : "");
+  for (int i = 0; i < listed; i++) {
+    printf("  ");
+    _printCycles(_functions[order[i]].wcet);
+    printf("  %s\n", _functions[order[i]].name);
+
+    if (_isHandler(&_functions[order[i]])
+        && _functions[order[i]].wcet > longestHandler) {
+      longestHandler = _functions[order[i]].wcet;
+      handler = order[i];
+    }
+  }
+
+  printf("\nBudgets:\n\n");
+
+  for (int r = 0; r < rootCount; r++) {
+    int64_t total = _responseTime(&roots[r], periodic, periodicCount);
+    bool over = total > roots[r].budget;
+
+    printf("  %-20s %8" PRId64 " with interrupts, of %" PRId64 "  %s\n",
+        _functions[roots[r].function].name, total, roots[r].budget,
+        over ? "OVER" : "ok");
+    failed |= over;
+  }
+
+  if (latency > 0) {
+    int64_t worst = _max(longestHandler + INTERRUPT_RESPONSE, longestOff)
+      + INTERRUPT_RESPONSE + LONGEST_INSTRUCTION;
+    bool over = worst > latency;
+
+    printf("  %-20s %8" PRId64 " of %" PRId64 "  %s\n",
+        "interrupt latency", worst, latency, over ? "OVER" : "ok");
+    if (handler >= 0) {
+      printf("    longest handler      %8" PRId64 "  %s\n",
+          longestHandler, _functions[handler].name);
+    }
+    if (offIn >= 0) {
+      printf("    interrupts off       %8" PRId64 "  in %s\n",
+          longestOff, _functions[offIn].name);
+    }
+    failed |= over;
+  }
+
+  if (_errors) {
+    printf("\n%d problem%s above, the bounds aren't complete\n", _errors,
+        _errors == 1 ? "" : "s");
+  }
+
+  return failed || _errors ? 1 : 0;
+}
@@ -1,18 +1,30 @@
-#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 #include "pingpong.h"
 #include "animation.h"
 #include "tonegen.h"
-#include "MAX72S19.h"
+#include "display.h"
 #include "button.h"
+#include "timing.h"
+#include "telemetry.h"
+#include "task.h"
+#include "settings.h"
+#include "counters.h"
+#include "records.h"
+#include "crc.h"
+#include "stats.h"
+#include "trace.h"
 #include "stdbool.h"
+#include "stddef.h"
 
 #define PINGPONG_STATE_IDLE     0
 #define PINGPONG_STATE_GAME     1
 #define PINGPONG_STATE_GAME_END 2
+// Choosing the profile of a player, before the first serve. currentPlayer is
+// the side being chosen for.
+#define PINGPONG_STATE_PICK     3
 
-#define PINGPONG_POINTS_TO_WIN 11
+// Points to win and to change serve are in settings
 #define PINGPONG_MIN_POINT_DIFF_TO_WIN 2
-#define PINGPONG_POINTS_TO_CHANGE_SERVE 2
 
 #define LED_PLAYER1     (6)
 #define LED_PLAYER2     (5)
@@ -27,187 +39,526 @@
     ? PINGPONG_PLAYER_2 \
     : PINGPONG_PLAYER_1)
 
-#define SAVE_DELAY_TICKS (500 * 30) //30 seconds
-
-static void _modeButtonPress();
-static void _modeButtonLongPress();
-static void _playerButtonPress(uint8_t);
-static void _playerButtonLongPress(uint8_t);
-static void _swapSides();
-static void _writeScore(uint8_t player, uint8_t score);
-static void _refreshDisplay();
-static uint8_t _getCurrentPlayer();
-static void _indicatePlayerTurn(uint8_t player);
-static void _addPoint(uint8_t player);
-static void _removePoint(uint8_t player);
-static void _toggleMode();
-static void _setMode(uint8_t);
-static void _resetScore();
-static bool _isGameOver();
-static uint8_t _getWinningPlayer();
-static void _endOfGame();
-static void _newGame();
-static void _indicateIfScoresSaved();
-
-static uint16_t eepromAddrPlayer1;
-static uint16_t eepromAddrPlayer2;
-
-static uint8_t _startingPlayer = PINGPONG_PLAYER_NONE;
-static uint8_t _currentPlayer = PINGPONG_PLAYER_NONE;
-static uint16_t _ticks;
-static uint8_t _state = PINGPONG_STATE_IDLE;
-static uint8_t _dispMode = PINGPONG_DISPMODE_NONE;
-static uint8_t _gameScores[] =    { 0, 0 };
-static uint8_t _setScores[] =     { 0, 0 };
-static uint8_t _allTimeScores[] = { 0, 0 };
-static uint8_t _cachedAllTimeScores[] = { 0, 0 };
-static uint32_t _scoresLastSaved;
-static void _saveScores();
-static Button * _playerButtons[2];
-static Button * _modeButton;
+#define SAVE_DELAY_TICKS \
+  ((uint16_t)settings.saveDelay * TIMING_TICKS_PER_SECOND)
+
+static void _dispatch(PingpongContext * ctx, uint8_t event, uint8_t player);
+static void _actStartGame(PingpongContext * ctx, uint8_t player);
+static void _actAddPoint(PingpongContext * ctx, uint8_t player);
+static void _actRemovePoint(PingpongContext * ctx, uint8_t player);
+static void _actNewGame(PingpongContext * ctx, uint8_t player);
+static void _actSwapSides(PingpongContext * ctx, uint8_t player);
+static void _actChordSwap(PingpongContext * ctx, uint8_t player);
+static void _actNextMode(PingpongContext * ctx, uint8_t player);
+static void _actResetGame(PingpongContext * ctx, uint8_t player);
+static void _actResetSet(PingpongContext * ctx, uint8_t player);
+static void _actResetAll(PingpongContext * ctx, uint8_t player);
+static void _actNewMatch(PingpongContext * ctx, uint8_t player);
+static void _actResetStats(PingpongContext * ctx, uint8_t player);
+static void _actPick(PingpongContext * ctx, uint8_t player);
+static void _actStepProfile(PingpongContext * ctx, uint8_t player);
+static void _actPickDone(PingpongContext * ctx, uint8_t player);
+static void _updateDisplay(PingpongContext * ctx);
+static void _writeScore(PingpongContext * ctx, uint8_t player, uint8_t score);
+static void _refreshDisplay(PingpongContext * ctx);
+static uint8_t _statsScore(PingpongContext * ctx, uint8_t side);
+static uint8_t _getCurrentPlayer(PingpongContext * ctx);
+static void _indicatePlayerTurn(PingpongContext * ctx, uint8_t player);
+static void _addPoint(PingpongContext * ctx, uint8_t player);
+static void _changeMode(PingpongContext * ctx, uint8_t);
+static void _setMode(PingpongContext * ctx, uint8_t);
+static bool _isGameOver(PingpongContext * ctx);
+static uint8_t _getWinningPlayer(PingpongContext * ctx);
+static void _endOfGame(PingpongContext * ctx);
+static uint8_t _gamePoints(PingpongContext * ctx);
+static void _newGame(PingpongContext * ctx);
+static void _setProfile(PingpongContext * ctx, uint8_t side, uint8_t profile);
+static void _loadRecords(PingpongContext * ctx);
+static void _indicateIfScoresSaved(PingpongContext * ctx);
+static void _saveScores(PingpongContext * ctx);
+static void _saveTask(Task * task);
+static bool _hasUnsavedScores(PingpongContext * ctx);
+static void _resetGame(PingpongContext * ctx);
+static void _sealGame(PingpongContext * ctx);
+static bool _isGameIntact(PingpongContext * ctx);
+static uint8_t _gameCrc(PingpongContext * ctx);
+
+//------------------------------------------------------------------------------
+// Game flow
+//------------------------------------------------------------------------------
+
+// What happened, the columns of the transition table. Player events pass the
+// player along to the action.
+#define EVENT_PLAYER_PRESS      0
+#define EVENT_PLAYER_LONG_PRESS 1
+#define EVENT_PLAYER_CHORD      2 // Both player buttons long pressed
+#define EVENT_MODE_PRESS        3
+#define EVENT_MODE_LONG_PRESS   4
+#define EVENTS                  5
+
+#define STATES    (PINGPONG_STATE_PICK + 1)
+#define DISPMODES (PINGPONG_DISPMODE_STATS + 1)
+
+// Actions, indexes into _actions. They only change game state and mark what
+// needs redrawing in the context's dirty bits; _dispatch redraws once at the
+// end. None of them loop, so their run time is a few dozen cycles plus
+// telemetry, and the redraw is bounded by the register writes in
+// _updateDisplay.
+#define ACT_NONE        0
+#define ACT_START_GAME  1
+#define ACT_ADD_POINT   2
+#define ACT_REMOVE      3
+#define ACT_NEW_GAME    4
+#define ACT_SWAP_SIDES  5
+#define ACT_CHORD_SWAP  6
+#define ACT_NEXT_MODE   7
+#define ACT_RESET_GAME  8
+#define ACT_RESET_SET   9
+#define ACT_RESET_ALL   10
+#define ACT_NEW_MATCH   11
+#define ACT_PICK        12
+#define ACT_STEP_PROF   13
+#define ACT_PICK_DONE   14
+#define ACT_RESET_STATS 15
+
+typedef void (*pingpongAction)(PingpongContext * ctx, uint8_t player);
+
+static const pingpongAction _actions[] PROGMEM = {
+  [ACT_NONE]        = NULL,
+  [ACT_START_GAME]  = _actStartGame,
+  [ACT_ADD_POINT]   = _actAddPoint,
+  [ACT_REMOVE]      = _actRemovePoint,
+  [ACT_NEW_GAME]    = _actNewGame,
+  [ACT_SWAP_SIDES]  = _actSwapSides,
+  [ACT_CHORD_SWAP]  = _actChordSwap,
+  [ACT_NEXT_MODE]   = _actNextMode,
+  [ACT_RESET_GAME]  = _actResetGame,
+  [ACT_RESET_SET]   = _actResetSet,
+  [ACT_RESET_ALL]   = _actResetAll,
+  [ACT_NEW_MATCH]   = _actNewMatch,
+  [ACT_PICK]        = _actPick,
+  [ACT_STEP_PROF]   = _actStepProfile,
+  [ACT_PICK_DONE]   = _actPickDone,
+  [ACT_RESET_STATS] = _actResetStats,
+};
+
+// Same action whatever the display mode
+#define ANY_MODE(act) { act, act, act, act, act }
+
+// [state][event][display mode] -> action. Display modes are, in order:
+// none (during startup), game, set, all time, stats.
+static const uint8_t _transitions[STATES][EVENTS][DISPMODES] PROGMEM = {
+  [PINGPONG_STATE_IDLE] = {
+    [EVENT_PLAYER_PRESS]      = ANY_MODE(ACT_START_GAME),
+    [EVENT_PLAYER_LONG_PRESS] = ANY_MODE(ACT_PICK),
+    [EVENT_PLAYER_CHORD]      = ANY_MODE(ACT_SWAP_SIDES),
+    [EVENT_MODE_PRESS]        = ANY_MODE(ACT_NEXT_MODE),
+    [EVENT_MODE_LONG_PRESS]   =
+      { ACT_NONE, ACT_NONE, ACT_RESET_SET, ACT_RESET_ALL, ACT_RESET_STATS },
+  },
+  [PINGPONG_STATE_GAME] = {
+    [EVENT_PLAYER_PRESS]      = ANY_MODE(ACT_ADD_POINT),
+    [EVENT_PLAYER_LONG_PRESS] = ANY_MODE(ACT_REMOVE),
+    [EVENT_PLAYER_CHORD]      = ANY_MODE(ACT_CHORD_SWAP),
+    [EVENT_MODE_PRESS]        = ANY_MODE(ACT_NEXT_MODE),
+    [EVENT_MODE_LONG_PRESS]   =
+      { ACT_NONE, ACT_RESET_GAME, ACT_RESET_SET, ACT_RESET_ALL,
+        ACT_RESET_STATS },
+  },
+  [PINGPONG_STATE_GAME_END] = {
+    [EVENT_PLAYER_PRESS]      = ANY_MODE(ACT_NEW_GAME),
+    [EVENT_PLAYER_LONG_PRESS] = ANY_MODE(ACT_REMOVE),
+    [EVENT_PLAYER_CHORD]      = ANY_MODE(ACT_SWAP_SIDES),
+    [EVENT_MODE_PRESS]        = ANY_MODE(ACT_NEXT_MODE),
+    [EVENT_MODE_LONG_PRESS]   =
+      { ACT_NONE, ACT_NEW_MATCH, ACT_RESET_SET, ACT_RESET_ALL,
+        ACT_RESET_STATS },
+  },
+  // Pressing the side's own button steps forward through the profiles, the
+  // other one back. Long pressing the other one switches sides.
+  [PINGPONG_STATE_PICK] = {
+    [EVENT_PLAYER_PRESS]      = ANY_MODE(ACT_STEP_PROF),
+    [EVENT_PLAYER_LONG_PRESS] = ANY_MODE(ACT_PICK),
+    [EVENT_PLAYER_CHORD]      = ANY_MODE(ACT_SWAP_SIDES),
+    [EVENT_MODE_PRESS]        = ANY_MODE(ACT_PICK_DONE),
+    [EVENT_MODE_LONG_PRESS]   = ANY_MODE(ACT_PICK_DONE),
+  },
+};
+
+// Parts of the display an action changed, redrawn by _updateDisplay
+#define DIRTY_SCORES (1 << 0)
+#define DIRTY_TURN   (1 << 1)
+#define DIRTY_MODE   (1 << 2)
+
+#define GAME_MAGIC 0xA8
 
 void pingpongInit(
+  PingpongContext * ctx,
   Button * p1Button, Button * p2Button, Button * modeButton,
-  uint16_t eepromP1, uint16_t eepromP2) {
-  _playerButtons[0] = p1Button;
-  _playerButtons[1] = p2Button;
-  _modeButton = modeButton;
-
-  eepromAddrPlayer1 = eepromP1;
-  eepromAddrPlayer2 = eepromP2;
-
-  _allTimeScores[0] = eeprom_read_word((uint16_t*)eepromAddrPlayer1);
-  _allTimeScores[1] = eeprom_read_word((uint16_t*)eepromAddrPlayer2);
-  _cachedAllTimeScores[0] = _allTimeScores[0];
-  _cachedAllTimeScores[1] = _allTimeScores[1];
+  uint8_t displayChip, uint8_t digitOffset, bool warmStart) {
+  PingpongGame * game = &ctx->game;
+
+  ctx->playerButtons[0] = p1Button;
+  ctx->playerButtons[1] = p2Button;
+  ctx->modeButton = modeButton;
+  ctx->firstDigit = displayChip * DISPLAY_MODULE_DIGITS + digitOffset;
+  ctx->dirty = 0;
+  ctx->pointRemoved = false;
+
+  // After a reset that kept power (watchdog, brownout, the reset line getting
+  // bumped) the game in progress can be picked up where it was left. Any all
+  // time scores that weren't saved to EEPROM yet will be by _saveScores, since
+  // they differ from the cached ones.
+  taskStart(&ctx->saveTask, _saveTask);
+
+  if (warmStart && _isGameIntact(ctx)) {
+    _loadRecords(ctx);
+    // Skip the startup sequence, straight back to the game
+    uint8_t dispMode = game->dispMode;
+    game->dispMode = PINGPONG_DISPMODE_NONE;
+    _changeMode(ctx, dispMode == PINGPONG_DISPMODE_NONE
+        ? PINGPONG_DISPMODE_GAME
+        : dispMode);
+    ctx->dirty |= DIRTY_TURN;
+    _updateDisplay(ctx);
+    _sealGame(ctx);
+    return;
+  }
 
-  animationTrigger(Startup);
+  _resetGame(ctx);
+  animationTrigger(Startup, ctx);
   tonegenTriggerMelody(StartupMelo);
 }
 
-void pingpongGameTick() {
-  _ticks++;
-  _saveScores();
-}
-
-void pingpongButtonPress(Button * button) {
+void pingpongButtonPress(PingpongContext * ctx, Button * button) {
   animationClear();
-  tonegenClear();
 
-  if (button == _modeButton) {
-    _modeButtonPress();
-    tonegenTriggerMelody(ButtonPressSfx);
-    return;
+  if (button == ctx->modeButton) {
+    _dispatch(ctx, EVENT_MODE_PRESS, PINGPONG_PLAYER_NONE);
+  } else {
+    _dispatch(ctx, EVENT_PLAYER_PRESS,
+        button == ctx->playerButtons[0]
+          ? PINGPONG_PLAYER_1
+          : PINGPONG_PLAYER_2);
   }
 
-  _playerButtonPress(
-      button == _playerButtons[0] ? PINGPONG_PLAYER_1 : PINGPONG_PLAYER_2);
   tonegenTriggerMelody(ButtonPressSfx);
+  _sealGame(ctx);
 }
 
-void pingpongButtonLongPress(Button * button) {
+void pingpongButtonLongPress(PingpongContext * ctx, Button * button) {
   animationClear();
-  tonegenClear();
 
-  if (button == _modeButton) {
-    _modeButtonLongPress();
-    tonegenTriggerMelody(ButtonLongPressSfx);
-    return;
+  if (button == ctx->modeButton) {
+    _dispatch(ctx, EVENT_MODE_LONG_PRESS, PINGPONG_PLAYER_NONE);
+  } else {
+    _dispatch(ctx,
+        ctx->playerButtons[0]->held && ctx->playerButtons[1]->held
+          ? EVENT_PLAYER_CHORD
+          : EVENT_PLAYER_LONG_PRESS,
+        button == ctx->playerButtons[0]
+          ? PINGPONG_PLAYER_1
+          : PINGPONG_PLAYER_2);
   }
 
-  _playerButtonLongPress(
-      button == _playerButtons[0] ? PINGPONG_PLAYER_1 : PINGPONG_PLAYER_2);
   tonegenTriggerMelody(ButtonLongPressSfx);
+  _sealGame(ctx);
 }
 
-void pingpongSetMode(uint8_t newMode) {
-  _setMode(newMode);
+void pingpongSetMode(PingpongContext * ctx, uint8_t newMode) {
+  _setMode(ctx, newMode);
+  _sealGame(ctx);
 }
 
-void pingpongIndicatePlayerTurn(uint8_t player) {
-  _indicatePlayerTurn(player);
+void pingpongIndicatePlayerTurn(PingpongContext * ctx, uint8_t player) {
+  _indicatePlayerTurn(ctx, player);
 }
 
-static void _modeButtonPress() {
-  _toggleMode();
+void pingpongRedraw(PingpongContext * ctx) {
+  ctx->dirty |= DIRTY_SCORES | DIRTY_TURN | DIRTY_MODE;
+  _updateDisplay(ctx);
 }
 
-static void _modeButtonLongPress() {
-  _resetScore();
+bool pingpongIsIdle(PingpongContext * ctx) {
+  return ctx->game.state == PINGPONG_STATE_IDLE;
 }
 
-static void _playerButtonPress(uint8_t player) {
-  switch (_state) {
-    case PINGPONG_STATE_IDLE:
-      if (_startingPlayer == PINGPONG_PLAYER_NONE) {
-        _startingPlayer = _currentPlayer = player;
-        _indicatePlayerTurn(_currentPlayer);
-        _state = PINGPONG_STATE_GAME;
-        break;
-      }
+uint8_t pingpongDigit(PingpongContext * ctx, uint8_t digit) {
+  return ctx->firstDigit + digit;
+}
 
-      _currentPlayer = _startingPlayer;
-      _indicatePlayerTurn(_currentPlayer);
-      _state = PINGPONG_STATE_GAME;
-      break;
+// One table lookup decides what an event does, then the display is brought up
+// to date in one go.
+static void _dispatch(PingpongContext * ctx, uint8_t event, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+  uint8_t act =
+    pgm_read_byte(&_transitions[game->state][event][game->dispMode]);
+  pingpongAction action = (pingpongAction)pgm_read_ptr(&_actions[act]);
+
+  if (action != NULL) action(ctx, player);
+  // Actions fit 4 bits
+  TRACE(TRACE_EVT_DISPATCH, game->state << 4 | act);
+  if (_hasUnsavedScores(ctx)) taskSignal(TASK_EVENT_SCORES);
+  _updateDisplay(ctx);
+}
 
-    case PINGPONG_STATE_GAME:
-       _addPoint(player);
-      break;
+static void _actStartGame(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
 
-    case PINGPONG_STATE_GAME_END:
-      _newGame();
-      break;
+  // The first player to press serves first, after that it alternates
+  if (game->startingPlayer == PINGPONG_PLAYER_NONE) {
+    game->startingPlayer = player;
   }
+
+  game->currentPlayer = game->startingPlayer;
+  game->state = PINGPONG_STATE_GAME;
+  ctx->dirty |= DIRTY_TURN;
 }
 
-static void _playerButtonLongPress(uint8_t player) {
-  if (_playerButtons[0]->held && _playerButtons[1]->held) {
-    // Undo point removal of player who first reached long press
-    // Gosh this whole thing could really do with unit tests
-    if (_state == PINGPONG_STATE_GAME) {
-      _addPoint(OTHER_PLAYER(player));
-    }
+static void _actAddPoint(PingpongContext * ctx, uint8_t player) {
+  _addPoint(ctx, player);
+}
 
-    _swapSides();
+static void _actRemovePoint(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  ctx->pointRemoved = false;
+  if (game->gameScores[player - 1] == 0) return;
+
+  bool wasGameOver = game->state == PINGPONG_STATE_GAME_END;
+  uint8_t prevWinner = PINGPONG_PLAYER_NONE;
+
+  if (wasGameOver) prevWinner = _getWinningPlayer(ctx);
+
+  game->gameScores[player - 1]--;
+
+  if (_isGameOver(ctx) && wasGameOver) {
+    // This doesn't change anything, so don't bother.
+    game->gameScores[player - 1]++;
     return;
   }
 
-  switch (_state) {
-    case PINGPONG_STATE_IDLE:
-      // Nothing to do in this case?
-      break;
+  ctx->pointRemoved = true;
+  telemetrySend(
+      TELEMETRY_EVT_UNDO, player, game->gameScores[0], game->gameScores[1]);
+  _changeMode(ctx, PINGPONG_DISPMODE_GAME);
+  game->currentPlayer = _getCurrentPlayer(ctx);
+  ctx->dirty |= DIRTY_SCORES | DIRTY_TURN;
+  // The serve of the point taken back
+  statsPointUndone(&game->stats, player - 1, game->currentPlayer - 1);
 
-    case PINGPONG_STATE_GAME:
-    case PINGPONG_STATE_GAME_END: // Fallthrough intentional
-      _removePoint(player);
-      break;
+  if (wasGameOver) {
+    // If game over is undone, revert set / all time score changes
+    game->setScores[prevWinner - 1]--;
+    game->allTimeScores[prevWinner - 1]--;
+    game->state = PINGPONG_STATE_GAME;
+    countersGameUndone();
+    statsGameUndone(&game->stats, prevWinner - 1, _gamePoints(ctx) + 1);
   }
 }
 
-static void _swapSides() {
-  uint8_t sw = _gameScores[0];
-  _gameScores[0] = _gameScores[1];
-  _gameScores[1] = sw;
+static void _actNewGame(PingpongContext * ctx, uint8_t player) {
+  _newGame(ctx);
+}
+
+static void _actSwapSides(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+  uint8_t sw;
+
+  sw = game->gameScores[0];
+  game->gameScores[0] = game->gameScores[1];
+  game->gameScores[1] = sw;
+
+  sw = game->setScores[0];
+  game->setScores[0] = game->setScores[1];
+  game->setScores[1] = sw;
+
+  sw = game->allTimeScores[0];
+  game->allTimeScores[0] = game->allTimeScores[1];
+  game->allTimeScores[1] = sw;
 
-  sw = _setScores[0];
-  _setScores[0] = _setScores[1];
-  _setScores[1] = sw;
+  // The players go along with their scores
+  sw = game->profiles[0];
+  game->profiles[0] = game->profiles[1];
+  game->profiles[1] = sw;
 
-  sw = _allTimeScores[0];
-  _allTimeScores[0] = _allTimeScores[1];
-  _allTimeScores[1] = sw;
+  sw = ctx->cachedAllTimeScores[0];
+  ctx->cachedAllTimeScores[0] = ctx->cachedAllTimeScores[1];
+  ctx->cachedAllTimeScores[1] = sw;
+
+  statsSwapSides(&game->stats);
+
+  ctx->dirty |= DIRTY_SCORES;
+
+  // Also ends choosing profiles, if that's where this came from
+  if (game->state == PINGPONG_STATE_PICK) _actPickDone(ctx, player);
+}
 
-  _refreshDisplay();
+static void _actChordSwap(PingpongContext * ctx, uint8_t player) {
+  // The player who first reached long press may have had a point removed by
+  // it, give that back before swapping. Not if there was none to remove.
+  // Gosh this whole thing could really do with unit tests
+  if (ctx->pointRemoved) _addPoint(ctx, OTHER_PLAYER(player));
+  ctx->pointRemoved = false;
+  _actSwapSides(ctx, player);
 }
 
-static void _writeScore(uint8_t player, uint8_t score) {
+// The stats mode goes through its pages before going back to the game
+static void _actNextMode(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+  uint8_t newDispMode = game->dispMode + 1;
+
+  if (game->dispMode == PINGPONG_DISPMODE_STATS
+      && game->statsPage + 1 < PINGPONG_STATS_PAGES) {
+    game->statsPage++;
+    ctx->dirty |= DIRTY_SCORES | DIRTY_MODE;
+    return;
+  }
+
+  game->statsPage = 0;
+  if (newDispMode > PINGPONG_DISPMODE_STATS) {
+    newDispMode = PINGPONG_DISPMODE_GAME;
+  }
+  _changeMode(ctx, newDispMode);
+}
+
+static void _actResetGame(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  // Reset score and current player
+  game->gameScores[0] = game->gameScores[1] = 0;
+  game->currentPlayer = game->startingPlayer;
+  ctx->dirty |= DIRTY_SCORES | DIRTY_TURN;
+}
+
+static void _actResetSet(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  game->setScores[0] = game->setScores[1] = 0;
+  ctx->dirty |= DIRTY_SCORES;
+}
+
+static void _actResetAll(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  game->allTimeScores[0] = game->allTimeScores[1] = 0;
+  game->setScores[0] = game->setScores[1] = 0;
+  ctx->dirty |= DIRTY_SCORES;
+}
+
+// Back to before the first serve, with a fresh set, so new players can pick
+// their profiles
+static void _actNewMatch(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  game->startingPlayer = PINGPONG_PLAYER_NONE;
+  game->setScores[0] = game->setScores[1] = 0;
+  statsReset(&game->stats);
+  _newGame(ctx);
+  ctx->dirty |= DIRTY_SCORES;
+}
+
+static void _actResetStats(PingpongContext * ctx, uint8_t player) {
+  statsReset(&ctx->game.stats);
+  ctx->dirty |= DIRTY_SCORES;
+}
+
+// Starts choosing the profile for the player's side, or finishes if it was
+// already being chosen
+static void _actPick(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  if (game->state == PINGPONG_STATE_PICK && game->currentPlayer == player) {
+    _actPickDone(ctx, player);
+    return;
+  }
+
+  game->state = PINGPONG_STATE_PICK;
+  game->currentPlayer = player;
+  ctx->dirty |= DIRTY_SCORES | DIRTY_TURN | DIRTY_MODE;
+}
+
+// Next or previous profile for the side being chosen for, skipping the one the
+// other side has
+static void _actStepProfile(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+  uint8_t side = game->currentPlayer - 1;
+  uint8_t profile = game->profiles[side];
+
+  do {
+    if (player == game->currentPlayer) {
+      profile = profile + 1 < RECORDS_PLAYERS ? profile + 1 : 0;
+    } else {
+      profile = profile > 0 ? profile - 1 : RECORDS_PLAYERS - 1;
+    }
+  } while (profile == game->profiles[!side]);
+
+  _setProfile(ctx, side, profile);
+}
+
+static void _actPickDone(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
+  game->state = PINGPONG_STATE_IDLE;
+  game->currentPlayer = PINGPONG_PLAYER_NONE;
+  ctx->dirty |= DIRTY_SCORES | DIRTY_TURN | DIRTY_MODE;
+}
+
+// Two or three of the mode LEDs at once for the stats pages, so they can't be
+// mistaken for the scores
+static const uint8_t _statsLeds[PINGPONG_STATS_PAGES] PROGMEM = {
+  [PINGPONG_STATS_STREAK]  = (1 << LED_DISPMODE_GAME) | (1 << LED_DISPMODE_SET),
+  [PINGPONG_STATS_LONGEST] = (1 << LED_DISPMODE_SET) | (1 << LED_DISPMODE_ALL),
+  [PINGPONG_STATS_SERVE]   = (1 << LED_DISPMODE_GAME) | (1 << LED_DISPMODE_ALL),
+  [PINGPONG_STATS_GAMES]   = (1 << LED_DISPMODE_GAME) | (1 << LED_DISPMODE_SET)
+                           | (1 << LED_DISPMODE_ALL),
+};
+
+// Redraws whatever the last action changed. At most the mode LEDs, four score
+// digits and the serve LEDs, and the display driver skips digits that didn't
+// change, so a single event costs at most 7 register writes.
+static void _updateDisplay(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
+  uint8_t dirty = ctx->dirty;
+
+  ctx->dirty = 0;
+
+  if (dirty & DIRTY_MODE) {
+    uint8_t leds;
+
+    // No mode LED while choosing profiles, those aren't scores
+    switch (game->state == PINGPONG_STATE_PICK
+        ? PINGPONG_DISPMODE_NONE
+        : game->dispMode) {
+      case PINGPONG_DISPMODE_NONE: leds = 0x00; break;
+      case PINGPONG_DISPMODE_SET:  leds = (1 << LED_DISPMODE_SET); break;
+      case PINGPONG_DISPMODE_ALL:  leds = (1 << LED_DISPMODE_ALL); break;
+      case PINGPONG_DISPMODE_STATS:
+        leds = pgm_read_byte(&_statsLeds[game->statsPage]);
+        break;
+      case PINGPONG_DISPMODE_GAME: // Fallthrough intentional
+      default:                    leds = (1 << LED_DISPMODE_GAME); break;
+    }
+
+    displaySetRow(pingpongDigit(ctx, LED_ROW_DISPMODE), leds);
+  }
+
+  if (dirty & (DIRTY_SCORES | DIRTY_MODE)) {
+    _refreshDisplay(ctx);
+    // Shares a digit with the scores, so goes after them
+    _indicateIfScoresSaved(ctx);
+  }
+
+  if (dirty & DIRTY_TURN) _indicatePlayerTurn(ctx, game->currentPlayer);
+}
+
+static void _writeScore(PingpongContext * ctx, uint8_t player, uint8_t score) {
   uint8_t digitIndex;
 
   // score assumed to be at most 99
   if (player == PINGPONG_PLAYER_NONE) return;
 
-  digitIndex = player == PINGPONG_PLAYER_1 ? 3 : 1;
+  digitIndex = pingpongDigit(ctx, player == PINGPONG_PLAYER_1 ? 3 : 1);
 
   if (score < 10) {
     displayWriteChar(digitIndex, ' ', false);
@@ -221,236 +572,322 @@ static void _writeScore(uint8_t player, uint8_t score) {
       player == PINGPONG_PLAYER_1);
 }
 
-static void _refreshDisplay() {
+static void _refreshDisplay(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
   uint8_t p1Score;
   uint8_t p2Score;
 
-  switch (_dispMode) {
+  if (game->state == PINGPONG_STATE_PICK) {
+    _writeScore(ctx, PINGPONG_PLAYER_1, game->profiles[0] + 1);
+    _writeScore(ctx, PINGPONG_PLAYER_2, game->profiles[1] + 1);
+    return;
+  }
+
+  switch (game->dispMode) {
     case PINGPONG_DISPMODE_SET:
-      p1Score = _setScores[0];
-      p2Score = _setScores[1];
+      p1Score = game->setScores[0];
+      p2Score = game->setScores[1];
       break;
 
     case PINGPONG_DISPMODE_ALL:
-      p1Score = _allTimeScores[0];
-      p2Score = _allTimeScores[1];
+      p1Score = game->allTimeScores[0];
+      p2Score = game->allTimeScores[1];
+      break;
+
+    case PINGPONG_DISPMODE_STATS:
+      p1Score = _statsScore(ctx, 0);
+      p2Score = _statsScore(ctx, 1);
       break;
 
     case PINGPONG_DISPMODE_GAME:
     default:
-      p1Score = _gameScores[0];
-      p2Score = _gameScores[1];
+      p1Score = game->gameScores[0];
+      p2Score = game->gameScores[1];
       break;
   }
 
-  _writeScore(PINGPONG_PLAYER_1, p1Score);
-  _writeScore(PINGPONG_PLAYER_2, p2Score);
+  _writeScore(ctx, PINGPONG_PLAYER_1, p1Score);
+  _writeScore(ctx, PINGPONG_PLAYER_2, p2Score);
+}
+
+// What a side shows on the stats page. The games page isn't per side: the
+// first one shows how often games went to deuce, the second how long they
+// were.
+static uint8_t _statsScore(PingpongContext * ctx, uint8_t side) {
+  GameStats * stats = &ctx->game.stats;
+
+  switch (ctx->game.statsPage) {
+    case PINGPONG_STATS_STREAK:  return statsStreak(stats, side);
+    case PINGPONG_STATS_LONGEST: return statsLongestStreak(stats, side);
+    case PINGPONG_STATS_SERVE:   return statsServePercent(stats, side);
+    case PINGPONG_STATS_GAMES:
+    default:
+      return side == 0 ? statsDeucePercent(stats) : statsAverageLength(stats);
+  }
 }
 
-static uint8_t _getCurrentPlayer() {
-  uint8_t combinedScore = _gameScores[0] + _gameScores[1];
-  uint8_t swpPoints = PINGPONG_POINTS_TO_CHANGE_SERVE;
+static uint8_t _getCurrentPlayer(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
+  uint8_t combinedScore = game->gameScores[0] + game->gameScores[1];
+  uint8_t swpPoints = settings.pointsToChangeServe;
 
   return combinedScore % (swpPoints * 2) < swpPoints 
-    ? _startingPlayer 
-    : OTHER_PLAYER(_startingPlayer);
+    ? game->startingPlayer 
+    : OTHER_PLAYER(game->startingPlayer);
 }
 
-static void _indicatePlayerTurn(uint8_t player) {
+static void _indicatePlayerTurn(PingpongContext * ctx, uint8_t player) {
   uint8_t ledOutput = (player == PINGPONG_PLAYER_NONE)
     ? 0x00
     : (player == PINGPONG_PLAYER_1)
       ? (1 << LED_PLAYER1)
       : (1 << LED_PLAYER2);
 
-  displaySetRow(LED_ROW_PLAYERS, ledOutput);
+  displaySetRow(pingpongDigit(ctx, LED_ROW_PLAYERS), ledOutput);
 }
 
-static void _addPoint(uint8_t player) {
+static void _addPoint(PingpongContext * ctx, uint8_t player) {
+  PingpongGame * game = &ctx->game;
+
   if (player == PINGPONG_PLAYER_NONE) return;
 
-  _gameScores[player - 1]++;
-  _refreshDisplay();
+  statsPoint(&game->stats, player - 1, _getCurrentPlayer(ctx) - 1);
+  game->gameScores[player - 1]++;
+  ctx->dirty |= DIRTY_SCORES;
+  telemetrySend(
+      TELEMETRY_EVT_POINT, player, game->gameScores[0], game->gameScores[1]);
 
-  if (_isGameOver()) {
-    _endOfGame();
+  if (_isGameOver(ctx)) {
+    _endOfGame(ctx);
   } else {
-    _currentPlayer = _getCurrentPlayer();
-    _indicatePlayerTurn(_currentPlayer);
+    game->currentPlayer = _getCurrentPlayer(ctx);
+    ctx->dirty |= DIRTY_TURN;
   }
 }
 
-static void _removePoint(uint8_t player) {
-  if (_state == PINGPONG_STATE_IDLE) return;
-  if (_gameScores[player - 1] == 0) return;
+// Changes the display mode, the redraw is left to _updateDisplay
+static void _changeMode(PingpongContext * ctx, uint8_t newMode) {
+  PingpongGame * game = &ctx->game;
 
-  bool wasGameOver = _state == PINGPONG_STATE_GAME_END;
-  uint8_t prevWinner = PINGPONG_PLAYER_NONE;
+  ctx->dirty |= DIRTY_SCORES;
 
-  if (wasGameOver) prevWinner = _getWinningPlayer();
+  if (game->dispMode == newMode) return;
 
-  _gameScores[player - 1]--;
+  game->dispMode = newMode;
+  telemetrySend(TELEMETRY_EVT_MODE, game->dispMode, 0, 0);
+  ctx->dirty |= DIRTY_MODE;
+}
 
-  if (_isGameOver() && wasGameOver) {
-    // This doesn't change anything, so don't bother.
-    _gameScores[player - 1]++;
-    return;
-  }
+// For callers outside the event dispatch, e.g. the end of the startup
+// animation
+static void _setMode(PingpongContext * ctx, uint8_t newMode) {
+  _changeMode(ctx, newMode);
+  _updateDisplay(ctx);
+}
 
-  _setMode(PINGPONG_DISPMODE_GAME);
-  _currentPlayer = _getCurrentPlayer();
-  _indicatePlayerTurn(_currentPlayer);
+static bool _isGameOver(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
+  int8_t p1Score = game->gameScores[0];
+  int8_t p2Score = game->gameScores[1];
+  int8_t scoreDiff = (p1Score > p2Score) > 0
+    ? (p1Score - p2Score)
+    : (p2Score - p1Score);
 
-  if (_state == PINGPONG_STATE_GAME_END && !_isGameOver()) {
-    // If game over is undone, revert set / all time score changes
-    _setScores[prevWinner - 1]--;
-    _allTimeScores[prevWinner - 1]--;
-    _state = PINGPONG_STATE_GAME;
+  if (p1Score < settings.pointsToWin && p2Score < settings.pointsToWin) {
+    return false;
   }
-}
 
-static void _toggleMode() {
-  uint8_t newDispMode = _dispMode + 1;
-  if (newDispMode > PINGPONG_DISPMODE_ALL) newDispMode = PINGPONG_DISPMODE_GAME;
-  _setMode(newDispMode);
-}
+  if (scoreDiff < PINGPONG_MIN_POINT_DIFF_TO_WIN) return false;
 
-static void _setMode(uint8_t newMode) {
-  if (_dispMode == newMode) {
-    _refreshDisplay();
-    return;
-  }
+  return true;
+}
 
-  _dispMode = newMode;
+// Assumes the game is indeed over.
+static uint8_t _getWinningPlayer(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
 
-  uint8_t leds;
+  return game->gameScores[0] > game->gameScores[1]
+    ? PINGPONG_PLAYER_1
+    : PINGPONG_PLAYER_2;
+}
 
-  switch (_dispMode) {
-    case PINGPONG_DISPMODE_NONE: leds = 0x00; break;
-    case PINGPONG_DISPMODE_SET:  leds = (1 << LED_DISPMODE_SET); break;
-    case PINGPONG_DISPMODE_ALL:  leds = (1 << LED_DISPMODE_ALL); break;
-    case PINGPONG_DISPMODE_GAME: // Fallthrough intentional
-    default:                    leds = (1 << LED_DISPMODE_GAME); break;
-  }
+static void _endOfGame(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
+  uint8_t winner = _getWinningPlayer(ctx);
+  // A game the loser got that far in went through both being one point from
+  // winning, anything else would have ended it earlier
+  bool deuce = game->gameScores[2 - winner] >= settings.pointsToWin - 1;
+
+  game->setScores[winner - 1]++;
+  game->allTimeScores[winner - 1]++;
+  game->state = PINGPONG_STATE_GAME_END;
+  countersGameEnded();
+  statsGameEnded(&game->stats, winner - 1, _gamePoints(ctx), deuce);
+  telemetrySend(
+      TELEMETRY_EVT_GAME_END, winner, game->setScores[0], game->setScores[1]);
+  tonegenTriggerMelody(WinMelo);
+  animationTrigger(
+      winner == PINGPONG_PLAYER_1 ? Player1Win : Player2Win, ctx);
+}
 
-  displaySetRow(LED_ROW_DISPMODE, leds);
-  _refreshDisplay();
-  _indicateIfScoresSaved();
+static uint8_t _gamePoints(PingpongContext * ctx) {
+  return ctx->game.gameScores[0] + ctx->game.gameScores[1];
 }
 
-static void _resetScore() {
-  switch (_dispMode) {
-    case PINGPONG_DISPMODE_NONE:
-      return;
+static void _newGame(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
 
-    case PINGPONG_DISPMODE_GAME:
-      switch (_state) {
-        case PINGPONG_STATE_IDLE:
-          return;
+  game->gameScores[0] = game->gameScores[1] = 0;
+  _changeMode(ctx, PINGPONG_DISPMODE_GAME);
+  ctx->dirty |= DIRTY_TURN;
 
-        case PINGPONG_STATE_GAME:
-          // Reset score and current player
-          _gameScores[0] = _gameScores[1] = 0;
-          _currentPlayer = _startingPlayer;
-          _indicatePlayerTurn(_currentPlayer);
-          _refreshDisplay();
-          return;
+  if (game->startingPlayer == PINGPONG_PLAYER_NONE) {
+    game->state = PINGPONG_STATE_IDLE;
+    game->currentPlayer = PINGPONG_PLAYER_NONE;
+    return;
+  }
 
-        case PINGPONG_STATE_GAME_END:
-          _newGame();
-          return;
-      }
+  game->startingPlayer = OTHER_PLAYER(game->startingPlayer);
+  game->currentPlayer = game->startingPlayer;
+  game->state = PINGPONG_STATE_GAME;
+}
 
-      return;
+// Saves all time scores a while after they change, rather than straight
+// away: a game end that gets undone doesn't cost an EEPROM write, and neither
+// do all the ones in between during a busy half minute.
+static void _saveTask(Task * task) {
+  PingpongContext * ctx = TASK_OWNER(task, PingpongContext, saveTask);
 
-    case PINGPONG_DISPMODE_SET:
-      _setScores[0] = _setScores[1] = 0;
-      _refreshDisplay();
-      return;
+  TASK_BEGIN(task);
 
-    case PINGPONG_DISPMODE_ALL:
-      _allTimeScores[0] = _allTimeScores[1] = 0;
-      _setScores[0] = _setScores[1] = 0;
-      _scoresLastSaved = _ticks;
-      _refreshDisplay();
-      return;
+  for (;;) {
+    // Woken up by any table's scores changing, not necessarily this one's
+    while (!_hasUnsavedScores(ctx)) {
+      TASK_WAIT_EVENT(task, TASK_EVENT_SCORES);
+    }
+
+    TASK_WAIT_TICKS(task, SAVE_DELAY_TICKS);
+    _saveScores(ctx);
   }
+
+  TASK_END(task);
 }
 
-static bool _isGameOver() {
-  int8_t p1Score = _gameScores[0];
-  int8_t p2Score = _gameScores[1];
-  int8_t scoreDiff = (p1Score > p2Score) > 0
-    ? (p1Score - p2Score)
-    : (p2Score - p1Score);
+static bool _hasUnsavedScores(PingpongContext * ctx) {
+  return ctx->cachedAllTimeScores[0] != ctx->game.allTimeScores[0]
+    || ctx->cachedAllTimeScores[1] != ctx->game.allTimeScores[1];
+}
 
-  if (p1Score < PINGPONG_POINTS_TO_WIN && p2Score < PINGPONG_POINTS_TO_WIN) {
-    return false;
+// Each side's all time score is its player's wins against the other player,
+// one counter in the head to head records. Only what changed since the last
+// save is added, see recordsAddWins.
+static void _saveScores(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
+  bool saved = false;
+
+  for (uint8_t i = 0; i < 2; i++) {
+    if (ctx->cachedAllTimeScores[i] == game->allTimeScores[i]) continue;
+
+    recordsAddWins(
+        game->profiles[i], game->profiles[!i],
+        (int16_t)game->allTimeScores[i] - ctx->cachedAllTimeScores[i]);
+    countersEepromWrite();
+    ctx->cachedAllTimeScores[i] = game->allTimeScores[i];
+    saved = true;
   }
 
-  if (scoreDiff < PINGPONG_MIN_POINT_DIFF_TO_WIN) return false;
+  if (saved) {
+    // Never more often than the scores, see counters.h
+    countersSave();
+    telemetrySend(
+        TELEMETRY_EVT_SAVE, game->allTimeScores[0], game->allTimeScores[1],
+        0);
+  }
 
-  return true;
+  _indicateIfScoresSaved(ctx);
 }
 
-// Assumes the game is indeed over.
-static uint8_t _getWinningPlayer() {
-  return _gameScores[0] > _gameScores[1]
-    ? PINGPONG_PLAYER_1
-    : PINGPONG_PLAYER_2;
-}
+static void _indicateIfScoresSaved(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
 
-static void _endOfGame() {
-  uint8_t winner = _getWinningPlayer();
+  if (game->dispMode != PINGPONG_DISPMODE_ALL) return;
+  if (game->state == PINGPONG_STATE_PICK) return;
+  if (_hasUnsavedScores(ctx)) return;
 
-  _setScores[winner - 1]++;
-  _allTimeScores[winner - 1]++;
-  _state = PINGPONG_STATE_GAME_END;
-  tonegenTriggerMelody(WinMelo);
-  animationTrigger(winner == PINGPONG_PLAYER_1 ? Player1Win : Player2Win);
+  displaySetLED(pingpongDigit(ctx, 0), 7, true);
 }
 
-static void _newGame() {
-  _gameScores[0] = _gameScores[1] = 0;
-  _setMode(PINGPONG_DISPMODE_GAME);
+// Saves anything unsaved of the current two players first, then switches
+// one side over to the given profile, and loads that pairing's records
+static void _setProfile(PingpongContext * ctx, uint8_t side, uint8_t profile) {
+  PingpongGame * game = &ctx->game;
 
-  if (_startingPlayer == PINGPONG_PLAYER_NONE) {
-    _state = PINGPONG_STATE_IDLE;
-    _currentPlayer = PINGPONG_PLAYER_NONE;
-    _indicatePlayerTurn(_currentPlayer);
-    return;
-  }
+  if (_hasUnsavedScores(ctx)) _saveScores(ctx);
 
-  _startingPlayer = OTHER_PLAYER(_startingPlayer);
-  _currentPlayer = _startingPlayer;
-  _indicatePlayerTurn(_currentPlayer);
-  _state = PINGPONG_STATE_GAME;
+  game->profiles[side] = profile;
+  _loadRecords(ctx);
+  game->allTimeScores[0] = ctx->cachedAllTimeScores[0];
+  game->allTimeScores[1] = ctx->cachedAllTimeScores[1];
+  ctx->dirty |= DIRTY_SCORES;
 }
 
-static void _saveScores() {
-  if (_ticks - _scoresLastSaved < SAVE_DELAY_TICKS) return;
+// All time scores of the two players, as saved in EEPROM
+static void _loadRecords(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
 
-  if (_cachedAllTimeScores[0] != _allTimeScores[0]) {
-    eeprom_write_word((uint16_t*)eepromAddrPlayer1, _allTimeScores[0]);
-    _cachedAllTimeScores[0] = _allTimeScores[0];
-  }
+  ctx->cachedAllTimeScores[0] =
+    recordsWins(game->profiles[0], game->profiles[1]);
+  ctx->cachedAllTimeScores[1] =
+    recordsWins(game->profiles[1], game->profiles[0]);
+}
 
-  if (_cachedAllTimeScores[1] != _allTimeScores[1]) {
-    eeprom_write_word((uint16_t*)eepromAddrPlayer2, _allTimeScores[1]);
-    _cachedAllTimeScores[1] = _allTimeScores[1];
-  }
+// A fresh game between the first two profiles, with all time scores as saved
+// in EEPROM. Sealed, so it can be restored after a warm reset.
+static void _resetGame(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
+
+  game->startingPlayer = PINGPONG_PLAYER_NONE;
+  game->currentPlayer = PINGPONG_PLAYER_NONE;
+  game->state = PINGPONG_STATE_IDLE;
+  game->dispMode = PINGPONG_DISPMODE_NONE;
+  game->gameScores[0] = game->gameScores[1] = 0;
+  game->setScores[0] = game->setScores[1] = 0;
+  game->profiles[0] = 0;
+  game->profiles[1] = 1;
+  game->statsPage = 0;
+  statsReset(&game->stats);
+  _loadRecords(ctx);
+  game->allTimeScores[0] = ctx->cachedAllTimeScores[0];
+  game->allTimeScores[1] = ctx->cachedAllTimeScores[1];
+
+  _sealGame(ctx);
+}
 
-  _scoresLastSaved = _ticks;
-  _indicateIfScoresSaved();
+// Marks the game as intact, for _isGameIntact after a warm reset. Called after
+// handling button presses, and other changes to the game. Costs a CRC over a
+// dozen bytes.
+static void _sealGame(PingpongContext * ctx) {
+  ctx->game.magic = GAME_MAGIC;
+  ctx->game.crc = _gameCrc(ctx);
 }
 
-static void _indicateIfScoresSaved() {
-  if (_dispMode != PINGPONG_DISPMODE_ALL) return;
+// Whether the game survived a reset. Protected by the magic byte and a CRC, as
+// after power-on the context is just random garbage.
+static bool _isGameIntact(PingpongContext * ctx) {
+  PingpongGame * game = &ctx->game;
 
-  if (_cachedAllTimeScores[0] != _allTimeScores[0] ||
-      _cachedAllTimeScores[1] != _allTimeScores[1]) {
-    return;
-  }
+  if (game->magic != GAME_MAGIC) return false;
+  if (game->crc != _gameCrc(ctx)) return false;
+  if (game->state > PINGPONG_STATE_PICK) return false;
+  if (game->dispMode > PINGPONG_DISPMODE_STATS) return false;
+  if (game->statsPage >= PINGPONG_STATS_PAGES) return false;
+  if (game->profiles[0] >= RECORDS_PLAYERS) return false;
+  if (game->profiles[1] >= RECORDS_PLAYERS) return false;
+  if (game->profiles[0] == game->profiles[1]) return false;
+
+  return true;
+}
 
-  displaySetLED(0, 7, true);
+static uint8_t _gameCrc(PingpongContext * ctx) {
+  return crc8(&ctx->game, offsetof(PingpongGame, crc));
 }
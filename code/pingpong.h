@@ -1,8 +1,11 @@
 #include "stdint.h"
+#include "stdbool.h"
 #include "button.h"
+#include "task.h"
+#include "stats.h"
 
 #ifndef PINGPONG_H_
- 
+
 #define PINGPONG_H_
 // TODO: enums are a thing
 #define PINGPONG_PLAYER_NONE 0
@@ -13,12 +16,78 @@
 #define PINGPONG_DISPMODE_GAME 1
 #define PINGPONG_DISPMODE_SET  2
 #define PINGPONG_DISPMODE_ALL  3
+// Match statistics, a page at a time, see stats.h
+#define PINGPONG_DISPMODE_STATS 4
+
+#define PINGPONG_STATS_STREAK  0 // Current win streak of each side
+#define PINGPONG_STATS_LONGEST 1 // Longest win streak of each side
+#define PINGPONG_STATS_SERVE   2 // % of points won on own serve, each side
+#define PINGPONG_STATS_GAMES   3 // % of games to deuce, points per game
+#define PINGPONG_STATS_PAGES   4
+
+// Display digits a table uses, from its first digit: four for the scores, and
+// two rows of indicator LEDs
+#define PINGPONG_DISPLAY_DIGITS 6
+
+// The part of a table's state that makes up the game, kept apart so it can be
+// checked and restored after a warm reset, see pingpongInit.
+typedef struct {
+  uint8_t magic;
+  uint8_t startingPlayer;
+  uint8_t currentPlayer;
+  uint8_t state;
+  uint8_t dispMode;
+  uint8_t gameScores[2];
+  uint8_t setScores[2];
+  // Head to head wins of each side's player against the other, see records.h
+  uint8_t allTimeScores[2];
+  uint8_t profiles[2]; // Of the player on each side
+  uint8_t statsPage;
+  GameStats stats;
+  uint8_t crc;
+} PingpongGame;
+
+// Everything about one table. There's no state in pingpong.c itself, so one
+// microcontroller can keep score for as many tables as it has buttons and
+// display digits for, each with a context of its own.
+typedef struct {
+  PingpongGame game;
+
+  // Set up by pingpongInit
+  Button * playerButtons[2];
+  Button * modeButton;
+  uint8_t firstDigit;
+
+  Task saveTask;
+  uint8_t cachedAllTimeScores[2];
+  uint8_t dirty;
+  // The last long press took a point away, which a chord that follows it
+  // gives back
+  bool pointRemoved;
+} PingpongContext;
+
+// Sets up a table: its buttons, and where it is on the display, as the chip
+// (or module, see display.h) and the digit on that chip its digits
+// start at. All tables share the head to head records in EEPROM.
+//
+// If warmStart is set, the game the context holds is picked up again if it
+// is still intact. Put contexts in .noinit for that, so the C runtime leaves
+// them alone at startup; anything else about the context is set up here.
+void pingpongInit(PingpongContext *, Button *, Button *, Button *,
+                  uint8_t displayChip, uint8_t digitOffset, bool warmStart);
+void pingpongButtonPress(PingpongContext *, Button *);
+void pingpongButtonLongPress(PingpongContext *, Button *);
+void pingpongSetMode(PingpongContext *, uint8_t);
+void pingpongIndicatePlayerTurn(PingpongContext *, uint8_t);
+// Draws the table's part of the display from scratch, after something else
+// used it
+void pingpongRedraw(PingpongContext *);
+
+// Waiting for a game to start, nothing in progress
+bool pingpongIsIdle(PingpongContext *);
 
-void pingpongInit(Button *, Button *, Button *, uint16_t, uint16_t);
-void pingpongGameTick();
-void pingpongButtonPress(Button *);
-void pingpongButtonLongPress(Button *);
-void pingpongSetMode(uint8_t);
-void pingpongIndicatePlayerTurn(uint8_t);
+// Display digit index of the given digit of the table, 0 to
+// PINGPONG_DISPLAY_DIGITS - 1
+uint8_t pingpongDigit(PingpongContext *, uint8_t);
 
 #endif /* PINGPONG_H_ */
@@ -0,0 +1,50 @@
+#include <avr/eeprom.h>
+#include "records.h"
+#include "stdbool.h"
+
+static uint16_t _bit(uint8_t player, uint8_t opponent);
+
+uint8_t recordsWins(uint8_t player, uint8_t opponent) {
+  uint16_t bit = _bit(player, opponent);
+  uint8_t * addr = (uint8_t *)RECORDS_EEPROM_ADDR + bit / 8;
+  uint16_t bits;
+  uint8_t wins;
+
+  bits = eeprom_read_byte(addr);
+  if (bit % 8 + RECORDS_BITS > 8) bits |= eeprom_read_byte(addr + 1) << 8;
+
+  wins = (bits >> (bit % 8)) & RECORDS_MASK;
+
+  return wins > RECORDS_MAX_WINS ? 0 : wins;
+}
+
+void recordsAddWins(uint8_t player, uint8_t opponent, int16_t wins) {
+  uint16_t bit = _bit(player, opponent);
+  uint8_t * addr = (uint8_t *)RECORDS_EEPROM_ADDR + bit / 8;
+  bool spans = bit % 8 + RECORDS_BITS > 8;
+  uint16_t mask = RECORDS_MASK << (bit % 8);
+  uint16_t bits;
+
+  wins += recordsWins(player, opponent);
+  if (wins < 0) wins = 0;
+  if (wins > RECORDS_MAX_WINS) wins = RECORDS_MAX_WINS;
+
+  bits = eeprom_read_byte(addr);
+  if (spans) bits |= eeprom_read_byte(addr + 1) << 8;
+
+  bits = (bits & ~mask) | ((uint16_t)wins << (bit % 8));
+
+  // Only bytes that changed are written
+  eeprom_update_byte(addr, bits & 0xFF);
+  if (spans) eeprom_update_byte(addr + 1, bits >> 8);
+}
+
+// Where the counter of player's wins against opponent starts, in bits from
+// RECORDS_EEPROM_ADDR
+static uint16_t _bit(uint8_t player, uint8_t opponent) {
+  uint8_t high = player > opponent ? player : opponent;
+  uint8_t low = player > opponent ? opponent : player;
+  uint16_t pair = (uint16_t)high * (high - 1) / 2 + low;
+
+  return (pair * 2 + (player > opponent)) * RECORDS_BITS;
+}
@@ -0,0 +1,56 @@
+#ifndef RECORDS_H_
+#define RECORDS_H_
+
+#include <avr/io.h>
+#include "stdint.h"
+
+// Head to head records of the players in a league: for every two players, how
+// many games each of them won against the other.
+//
+// Players are profiles numbered from 0, shown from 1 on the display. Every
+// ordered pair gets a counter, packed into EEPROM as a triangular matrix: the
+// unordered pairs row by row through the lower triangle, (1,0), (2,0), (2,1),
+// (3,0)..., two counters each, RECORDS_BITS wide with no padding. Finding a
+// counter is a multiply and a shift, and updating one rewrites at most the two
+// bytes it spans.
+
+// Profiles to choose from
+#ifndef RECORDS_PLAYERS
+#define RECORDS_PLAYERS 20
+#endif
+
+// After the counters, up to the end of EEPROM. 0x00-0x1F held the all time
+// scores of each side before there were profiles, and is unused now.
+#define RECORDS_EEPROM_ADDR 0x48
+#define RECORDS_EEPROM_SIZE (E2END + 1 - RECORDS_EEPROM_ADDR)
+
+#define RECORDS_COUNTERS (RECORDS_PLAYERS * (RECORDS_PLAYERS - 1))
+#define RECORDS_FIT_BITS (RECORDS_EEPROM_SIZE * 8 / RECORDS_COUNTERS)
+
+// 7 bits hold the 99 wins the display can show. With more players counters
+// get narrower, to still fit.
+#if RECORDS_FIT_BITS >= 7
+#define RECORDS_BITS 7
+#else
+#define RECORDS_BITS RECORDS_FIT_BITS
+#endif
+
+#if RECORDS_BITS < 4
+#error "Too many RECORDS_PLAYERS for head to head records to fit EEPROM"
+#endif
+
+#define RECORDS_MASK ((1 << RECORDS_BITS) - 1)
+
+// Counters stop here. All ones is kept free, it's erased EEPROM and reads as
+// no wins, so a fresh chip needs no clearing.
+#define RECORDS_MAX_WINS (RECORDS_MASK - 1 < 99 ? RECORDS_MASK - 1 : 99)
+
+// Games player won against opponent
+uint8_t recordsWins(uint8_t player, uint8_t opponent);
+
+// Adds to (or takes off, when negative) the games player won against
+// opponent, staying within 0 and RECORDS_MAX_WINS. Adding rather than setting
+// keeps two tables with the same two players from overwriting each other.
+void recordsAddWins(uint8_t player, uint8_t opponent, int16_t wins);
+
+#endif // RECORDS_H_
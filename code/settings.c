@@ -0,0 +1,141 @@
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include "settings.h"
+#include "display.h"
+#include "counters.h"
+#include "crc.h"
+#include "stddef.h"
+
+// Digits the menu uses, on the first table's part of the display
+#define DIGIT_LABEL 3 // And the one right of it
+#define DIGIT_VALUE 1 // Tens, ones in the next digit
+
+// A setting in the menu. Values go from min to max in steps, and wrap around.
+typedef struct {
+  char label[2];
+  uint8_t offset; // In Settings
+  uint8_t min;
+  uint8_t max;
+  uint8_t step;
+} SettingsItem;
+
+static const SettingsItem _items[] PROGMEM = {
+  { { 'P', 't' }, offsetof(Settings, pointsToWin),         11, 21, 10 },
+  { { 'S', 'r' }, offsetof(Settings, pointsToChangeServe),  1,  5,  1 },
+  { { 'S', 'o' }, offsetof(Settings, sound),                0,  1,  1 },
+  { { 'b', 'r' }, offsetof(Settings, brightness),           0, 15,  1 },
+  { { 'S', 'A' }, offsetof(Settings, saveDelay),            5, 95,  5 },
+};
+
+#define ITEMS (sizeof(_items) / sizeof(SettingsItem))
+
+static const Settings _defaults PROGMEM = {
+  .version = SETTINGS_VERSION,
+  .pointsToWin = 11,
+  .pointsToChangeServe = 2,
+  .sound = 1,
+  .brightness = 0xF,
+  .saveDelay = 30,
+};
+
+Settings settings;
+
+static uint8_t _menuItem;
+
+static uint8_t _crc();
+static bool _isValid();
+static void _showItem();
+
+void settingsLoad() {
+  eeprom_read_block(
+      &settings, (const void *)SETTINGS_EEPROM_ADDR, sizeof(Settings));
+
+  if (_isValid()) return;
+
+  settingsDefaults();
+  settingsSave();
+}
+
+void settingsDefaults() {
+  memcpy_P(&settings, &_defaults, sizeof(Settings));
+  settings.crc = _crc();
+}
+
+void settingsSave() {
+  settings.crc = _crc();
+  // Only bytes that changed are written
+  eeprom_update_block(
+      &settings, (void *)SETTINGS_EEPROM_ADDR, sizeof(Settings));
+  countersEepromWrite();
+}
+
+void settingsMenuOpen() {
+  _menuItem = 0;
+  displayClear();
+  _showItem();
+}
+
+void settingsMenuNext() {
+  if (++_menuItem >= ITEMS) _menuItem = 0;
+  _showItem();
+}
+
+void settingsMenuAdjust(bool up) {
+  SettingsItem item;
+  uint8_t * value;
+
+  memcpy_P(&item, &_items[_menuItem], sizeof(SettingsItem));
+  value = (uint8_t *)&settings + item.offset;
+
+  if (up) {
+    *value = *value >= item.max ? item.min : *value + item.step;
+  } else {
+    *value = *value <= item.min ? item.max : *value - item.step;
+  }
+
+  // So the effect can be seen while choosing
+  if (item.offset == offsetof(Settings, brightness)) {
+    displaySetIntensity(settings.brightness);
+  }
+
+  _showItem();
+}
+
+void settingsMenuClose() {
+  settingsSave();
+  displayClear();
+}
+
+static void _showItem() {
+  SettingsItem item;
+  uint8_t value;
+
+  memcpy_P(&item, &_items[_menuItem], sizeof(SettingsItem));
+  value = *((uint8_t *)&settings + item.offset);
+
+  displayWriteChar(DIGIT_LABEL, item.label[0], false);
+  displayWriteChar(DIGIT_LABEL - 1, item.label[1], false);
+  displayWriteChar(
+      DIGIT_VALUE, value < 10 ? ' ' : '0' + value / 10, false);
+  displayWriteChar(DIGIT_VALUE - 1, '0' + value % 10, false);
+}
+
+static bool _isValid() {
+  SettingsItem item;
+  uint8_t value;
+
+  if (settings.version != SETTINGS_VERSION) return false;
+  if (settings.crc != _crc()) return false;
+
+  for (uint8_t i = 0; i < ITEMS; i++) {
+    memcpy_P(&item, &_items[i], sizeof(SettingsItem));
+    value = *((uint8_t *)&settings + item.offset);
+    if (value < item.min || value > item.max) return false;
+  }
+
+  return true;
+}
+
+static uint8_t _crc() {
+  return crc8(&settings, offsetof(Settings, crc));
+}
@@ -0,0 +1,48 @@
+#ifndef SETTINGS_H_
+#define SETTINGS_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Settings that can be changed without reflashing, kept in EEPROM.
+//
+// Read once at startup, in one block, into the RAM copy below. Everything
+// else only ever reads that, so there's no EEPROM access during play. Only the
+// settings menu changes them, and writes them back when it is closed.
+//
+// The block carries a version and a CRC. If either doesn't match, or a value
+// is out of range, the defaults are used and written back. Bump the version
+// whenever the struct changes.
+
+#define SETTINGS_VERSION 1
+
+// Past what used to be the all time scores of each table, see records.h
+#define SETTINGS_EEPROM_ADDR 0x20
+
+typedef struct {
+  uint8_t version;
+  uint8_t pointsToWin;
+  uint8_t pointsToChangeServe;
+  uint8_t sound; // 0 for off
+  uint8_t brightness; // Display intensity, 0-15
+  uint8_t saveDelay; // Seconds between all time scores changing and saving
+  uint8_t crc;
+} Settings;
+
+extern Settings settings;
+
+// Loads settings from EEPROM, or the defaults if what's there isn't valid
+void settingsLoad();
+void settingsDefaults();
+void settingsSave();
+
+// The settings menu, on the first four digits of the display. Shows one
+// setting at a time: a two letter name, and its value.
+void settingsMenuOpen();
+void settingsMenuNext();
+// Changes the value shown by one step, wrapping around
+void settingsMenuAdjust(bool up);
+// Saves any changes
+void settingsMenuClose();
+
+#endif // SETTINGS_H_
@@ -0,0 +1,83 @@
+#include <avr/io.h>
+#include "stackmon.h"
+#include "telemetry.h"
+#include "trace.h"
+
+// Bytes looked at per call. A whole pass up from the globals takes a few
+// calls, but keeps each one short enough for every tick.
+#define STACKMON_CHUNK 32
+
+// End of .data, .bss and .noinit, from the linker script
+extern uint8_t _end;
+
+void _stackmonPaint() __attribute__((naked, used, section(".init1")));
+
+// Lowest address known to have been used by the stack
+static volatile uint8_t * _freeTop = (volatile uint8_t *)(RAMEND + 1);
+// Where the pass up from the globals got to
+static volatile uint8_t * _scan = &_end;
+static uint16_t _minFree = 0xFFFF;
+static bool _fault;
+
+// Runs as part of the startup code, before the stack pointer is set up and r1
+// is cleared, so this can't be C. Everything above the globals gets the
+// pattern, up to and including RAMEND.
+void _stackmonPaint() {
+  __asm__ volatile (
+    "  ldi r30, lo8(_end)     \n"
+    "  ldi r31, hi8(_end)     \n"
+    "  ldi r24, %[canary]     \n"
+    "  ldi r25, hi8(%[top])   \n"
+    "1:                       \n"
+    "  st Z+, r24             \n"
+    "  cpi r30, lo8(%[top])   \n"
+    "  cpc r31, r25           \n"
+    "  brlo 1b                \n"
+    :
+    : [canary] "M" (STACKMON_CANARY), [top] "i" (RAMEND + 1));
+}
+
+// Goes up from the globals to the first byte that isn't paint any more. Going
+// down from the high water mark instead would stop at any gap of paint a
+// deeper frame left, like locals that were never stored, and never look below
+// it again.
+void stackmonCheck() {
+  volatile uint8_t * bottom = &_end;
+  volatile uint8_t * p = _scan;
+  volatile uint8_t * end = p + STACKMON_CHUNK;
+  uint16_t free;
+
+  if (end > _freeTop) end = _freeTop;
+  while (p < end && *p == STACKMON_CANARY) p++;
+
+  if (p == end) {
+    // All paint so far, on with the pass, or from the bottom again once it
+    // got to the high water mark
+    _scan = p < _freeTop ? p : bottom;
+    return;
+  }
+
+  _scan = bottom;
+  _freeTop = p;
+  free = p - bottom;
+
+  if (free >= _minFree) return;
+
+  _minFree = free;
+  if (free < STACKMON_MARGIN && !_fault) {
+    _fault = true;
+    // Keep what led up to it
+    TRACE(TRACE_EVT_STACK, free > 0xFF ? 0xFF : free);
+    traceFreeze();
+  }
+
+  telemetrySend(TELEMETRY_EVT_STACK, free & 0xFF, free >> 8, _fault);
+}
+
+uint16_t stackmonMinFree() {
+  return _minFree;
+}
+
+bool stackmonFault() {
+  return _fault;
+}
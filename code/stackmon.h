@@ -0,0 +1,31 @@
+#ifndef STACKMON_H_
+#define STACKMON_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Stack high water mark.
+//
+// All SRAM between the end of the globals and the top of RAM is painted with
+// STACKMON_CANARY before main runs. The stack grows down into that, so the
+// bytes still holding the pattern are stack that has never been used, by main
+// or by any interrupt. stackmonCheck keeps track of how many are left.
+
+#define STACKMON_CANARY 0xC5
+
+// Fault is latched when less than this is left, before the stack actually
+// runs into the globals. Roughly one more interrupt frame on the deepest call.
+#define STACKMON_MARGIN 32
+
+// Cheap enough to call every tick: each call looks at a few dozen bytes, going
+// up from the globals to the lowest byte the stack ever used over a few calls.
+// A used byte that happens to hold the pattern counts as free.
+void stackmonCheck();
+
+// Fewest bytes between the stack and the globals seen so far
+uint16_t stackmonMinFree();
+
+// Set once the free stack went under STACKMON_MARGIN, stays set until reset
+bool stackmonFault();
+
+#endif /* STACKMON_H_ */
@@ -0,0 +1,133 @@
+#include "stats.h"
+
+#define MAX_SHOWN 99
+
+// What the last game end did, in GameStats.undo
+#define UNDO_COUNTED (1 << 0) // Counted at all, it isn't with 255 games
+#define UNDO_LONGEST (1 << 1) // Made the streak the side's longest
+#define UNDO_DEUCE   (1 << 2)
+
+static uint8_t _percent(uint16_t part, uint16_t whole);
+static uint8_t _shown(uint16_t value);
+
+void statsReset(GameStats * stats) {
+  uint8_t * data = (uint8_t *)stats;
+
+  for (uint8_t i = 0; i < sizeof(GameStats); i++) data[i] = 0;
+}
+
+void statsPoint(GameStats * stats, uint8_t side, uint8_t server) {
+  stats->served[server]++;
+  if (side == server) stats->wonOnServe[server]++;
+}
+
+// After a reset of the stats, the point being taken back may not have been
+// counted, hence the checks
+void statsPointUndone(GameStats * stats, uint8_t side, uint8_t server) {
+  if (stats->served[server] > 0) stats->served[server]--;
+  if (side == server && stats->wonOnServe[server] > 0) {
+    stats->wonOnServe[server]--;
+  }
+}
+
+// A win by the other side breaks the streak. Its length is kept, to bring it
+// back if this gets undone.
+void statsGameEnded(GameStats * stats, uint8_t side, uint8_t points,
+                    bool deuce) {
+  stats->undo = 0;
+  if (stats->games == UINT8_MAX) return;
+
+  stats->games++;
+  stats->points += points;
+  if (deuce) {
+    stats->deuces++;
+    stats->undo |= UNDO_DEUCE;
+  }
+
+  stats->brokenStreak = 0;
+  if (stats->streakSide != side) {
+    stats->brokenStreak = stats->streak;
+    stats->streakSide = side;
+    stats->streak = 0;
+  }
+
+  stats->streak++;
+  if (stats->streak > stats->longest[side]) {
+    stats->longest[side] = stats->streak;
+    stats->undo |= UNDO_LONGEST;
+  }
+
+  stats->undo |= UNDO_COUNTED;
+}
+
+void statsGameUndone(GameStats * stats, uint8_t side, uint8_t points) {
+  uint8_t undo = stats->undo;
+
+  stats->undo = 0;
+  if (!(undo & UNDO_COUNTED)) return;
+
+  stats->games--;
+  stats->points -= points;
+  if (undo & UNDO_DEUCE) stats->deuces--;
+  if (undo & UNDO_LONGEST) stats->longest[side]--;
+
+  stats->streak--;
+  if (stats->brokenStreak > 0) {
+    stats->streakSide = !side;
+    stats->streak = stats->brokenStreak;
+    stats->brokenStreak = 0;
+  }
+}
+
+void statsSwapSides(GameStats * stats) {
+  uint16_t sw;
+  uint8_t sw8;
+
+  sw = stats->served[0];
+  stats->served[0] = stats->served[1];
+  stats->served[1] = sw;
+
+  sw = stats->wonOnServe[0];
+  stats->wonOnServe[0] = stats->wonOnServe[1];
+  stats->wonOnServe[1] = sw;
+
+  sw8 = stats->longest[0];
+  stats->longest[0] = stats->longest[1];
+  stats->longest[1] = sw8;
+
+  stats->streakSide = !stats->streakSide;
+}
+
+uint8_t statsStreak(GameStats * stats, uint8_t side) {
+  return stats->streakSide == side ? _shown(stats->streak) : 0;
+}
+
+uint8_t statsLongestStreak(GameStats * stats, uint8_t side) {
+  return _shown(stats->longest[side]);
+}
+
+// Points a side won on the other side's serve are the other side's serves it
+// lost, so they're 100 minus the other side's number
+uint8_t statsServePercent(GameStats * stats, uint8_t side) {
+  return _percent(stats->wonOnServe[side], stats->served[side]);
+}
+
+uint8_t statsDeucePercent(GameStats * stats) {
+  return _percent(stats->deuces, stats->games);
+}
+
+uint8_t statsAverageLength(GameStats * stats) {
+  if (stats->games == 0) return 0;
+  return _shown((stats->points + stats->games / 2) / stats->games);
+}
+
+// Private methods
+
+static uint8_t _percent(uint16_t part, uint16_t whole) {
+  if (whole == 0) return 0;
+  return _shown(((uint32_t)part * 100 + whole / 2) / whole);
+}
+
+static uint8_t _shown(uint16_t value) {
+  return value > MAX_SHOWN ? MAX_SHOWN : value;
+}
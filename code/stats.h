@@ -0,0 +1,49 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Match statistics of a table, for the stats display mode: win streaks, how
+// often games go to deuce, points won on serve, and how long games are.
+//
+// Kept as running sums and counts, updated as points and games are scored,
+// so nothing ever goes back over the history. Every update can be reversed
+// when a point or the end of a game is undone; averages and percentages are
+// only worked out when they are shown. Sides are 0 and 1, like the scores,
+// and the numbers go along with the players when they swap sides.
+typedef struct {
+  uint8_t games;    // Finished, up to 255, after that no more are counted
+  uint8_t deuces;   // Of those, games that went to deuce
+  uint16_t points;  // Played in those games
+  uint16_t served[2];     // Points each side served
+  uint16_t wonOnServe[2]; // Of those, points the server won
+  uint8_t streakSide;
+  uint8_t streak;   // Games in a row won by streakSide, 0 if none yet
+  uint8_t longest[2]; // Longest streak of each side
+  // What the last game end changed, to undo it, see statsGameUndone
+  uint8_t brokenStreak;
+  uint8_t undo;
+} GameStats;
+
+void statsReset(GameStats *);
+
+// A point won by a side, and the side that served it
+void statsPoint(GameStats *, uint8_t side, uint8_t server);
+void statsPointUndone(GameStats *, uint8_t side, uint8_t server);
+
+// A game won by a side, with the points it took. Only the last game end can
+// be undone, with the same side and points, and only until the next one.
+void statsGameEnded(GameStats *, uint8_t side, uint8_t points, bool deuce);
+void statsGameUndone(GameStats *, uint8_t side, uint8_t points);
+
+void statsSwapSides(GameStats *);
+
+// What's shown, capped at 99 to fit two digits
+uint8_t statsStreak(GameStats *, uint8_t side); // 0 if the other side's
+uint8_t statsLongestStreak(GameStats *, uint8_t side);
+uint8_t statsServePercent(GameStats *, uint8_t side); // Won on own serve
+uint8_t statsDeucePercent(GameStats *);
+uint8_t statsAverageLength(GameStats *); // Points per game, rounded
+
+#endif // STATS_H_
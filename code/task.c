@@ -0,0 +1,133 @@
+#include "task.h"
+
+#define TASK_STOPPED  0
+#define TASK_READY    1
+#define TASK_RUNNING  2
+#define TASK_SLEEPING 3
+#define TASK_WAITING  4
+
+// Due to run, in no particular order
+static Task * _ready;
+// Sorted by wake up time. Each one's ticks are counted from the one before,
+// so only the first one has to be counted down.
+static Task * _sleeping;
+static Task * _waiting;
+
+static Task ** _listFor(uint8_t state) {
+  switch (state) {
+    case TASK_READY:    return &_ready;
+    case TASK_SLEEPING: return &_sleeping;
+    case TASK_WAITING:  return &_waiting;
+    default:            return NULL;
+  }
+}
+
+// Takes a task off whatever list it is on. Lists are a handful of tasks long.
+static void _unlink(Task * task) {
+  Task ** link = _listFor(task->state);
+
+  if (link == NULL) return;
+
+  while (*link != NULL && *link != task) link = &(*link)->next;
+  if (*link == NULL) return;
+
+  *link = task->next;
+
+  // The next one to wake up was counted from this one
+  if (task->state == TASK_SLEEPING && task->next != NULL) {
+    task->next->wait.ticks += task->wait.ticks;
+  }
+
+  task->state = TASK_STOPPED;
+}
+
+static void _makeReady(Task * task) {
+  task->state = TASK_READY;
+  task->next = _ready;
+  _ready = task;
+}
+
+void taskStart(Task * task, taskFunction run) {
+  _unlink(task);
+  task->run = run;
+  task->resume = 0;
+  _makeReady(task);
+}
+
+void taskStop(Task * task) {
+  _unlink(task);
+  task->state = TASK_STOPPED;
+}
+
+bool taskIsRunning(Task * task) {
+  return task->state != TASK_STOPPED;
+}
+
+void taskSleep(Task * task, uint16_t ticks) {
+  Task ** link = &_sleeping;
+
+  _unlink(task);
+
+  // Waking up in the same tick isn't a thing, it would never give way
+  if (ticks == 0) ticks = 1;
+
+  while (*link != NULL && (*link)->wait.ticks <= ticks) {
+    ticks -= (*link)->wait.ticks;
+    link = &(*link)->next;
+  }
+
+  if (*link != NULL) (*link)->wait.ticks -= ticks;
+
+  task->wait.ticks = ticks;
+  task->next = *link;
+  task->state = TASK_SLEEPING;
+  *link = task;
+}
+
+void taskWait(Task * task, uint8_t events) {
+  _unlink(task);
+  task->wait.events = events;
+  task->state = TASK_WAITING;
+  task->next = _waiting;
+  _waiting = task;
+}
+
+void taskSignal(uint8_t events) {
+  Task ** link = &_waiting;
+
+  while (*link != NULL) {
+    Task * task = *link;
+
+    if (task->wait.events & events) {
+      *link = task->next;
+      _makeReady(task);
+    } else {
+      link = &task->next;
+    }
+  }
+}
+
+void taskTick() {
+  Task * task;
+
+  if (_sleeping != NULL) _sleeping->wait.ticks--;
+
+  // Anything else sleeping until now has 0 ticks left after it
+  while (_sleeping != NULL && _sleeping->wait.ticks == 0) {
+    task = _sleeping;
+    _sleeping = task->next;
+    _makeReady(task);
+  }
+
+  // Tasks put themselves on another list before they return, or stop.
+  // Anything they start or wake up runs in this same loop.
+  while (_ready != NULL) {
+    task = _ready;
+    _ready = task->next;
+    task->state = TASK_RUNNING;
+    task->run(task);
+
+    // Returned without a TASK_ macro, not much else to do with it
+    if (task->state == TASK_RUNNING) task->state = TASK_STOPPED;
+  }
+}
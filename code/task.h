@@ -0,0 +1,93 @@
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+#include "stddef.h"
+
+// Stackless coroutines, protothread style, for sequences that take more than
+// one tick: an animation, a melody, a delayed save.
+//
+// A task is a function that runs from the top every time it is resumed, and
+// jumps to where it left off with a switch on the line it stopped at. So a
+// sequence is written as straight line code, with waits in between:
+//
+//   static void _blinkTask(Task * task) {
+//     TASK_BEGIN(task);
+//     for (_blinks = 0; _blinks < 10; _blinks++) {
+//       displaySetLED(0, 7, _blinks % 2);
+//       TASK_WAIT_TICKS(task, TIMING_MS_TO_TICKS(200));
+//     }
+//     TASK_END(task);
+//   }
+//
+// There is no stack of its own, so local variables don't survive a wait, keep
+// anything that has to in a static or in the task's owner (TASK_OWNER). Waits
+// can't be inside a switch statement either, since they're case labels.
+//
+// Waiting tasks cost nothing per tick: sleeping ones are kept in a list sorted
+// by wake up time, where only the first one is counted down, and ones waiting
+// for an event are only looked at when it is signalled.
+
+struct Task;
+typedef void (*taskFunction)(struct Task *);
+
+typedef struct Task {
+  struct Task * next; // In the ready, sleeping or waiting list
+  taskFunction run;
+  uint16_t resume; // Line to carry on from, 0 to start at the top
+  union {
+    uint16_t ticks; // Sleeping: ticks after the task before it in the list
+    uint8_t events; // Waiting: events it waits for
+  } wait;
+  uint8_t state;
+} Task;
+
+// Events tasks can wait for, a bit each
+#define TASK_EVENT_SCORES (1 << 0) // All time scores changed, see pingpong.c
+
+#define TASK_BEGIN(task) switch ((task)->resume) { case 0:
+
+#define TASK_END(task) } taskStop(task); return
+
+// Gives the other tasks, and everything else in the main loop, a go. Carries
+// on next tick.
+#define TASK_YIELD(task) TASK_WAIT_TICKS(task, 1)
+
+#define TASK_WAIT_TICKS(task, ticks) do { \
+    taskSleep((task), (ticks)); \
+    (task)->resume = __LINE__; \
+    return; \
+    case __LINE__:; \
+  } while (0)
+
+// Carries on once any of the events is signalled, in the same tick
+#define TASK_WAIT_EVENT(task, events) do { \
+    taskWait((task), (events)); \
+    (task)->resume = __LINE__; \
+    return; \
+    case __LINE__:; \
+  } while (0)
+
+// The struct a task is a member of, for tasks that are part of something
+#define TASK_OWNER(task, type, member) \
+  ((type *)((char *)(task) - offsetof(type, member)))
+
+// (Re)starts a task from the top, on the next taskTick. Anything the task was
+// waiting for is forgotten.
+void taskStart(Task *, taskFunction);
+void taskStop(Task *);
+bool taskIsRunning(Task *);
+
+// Wakes up tasks waiting for any of the events. They run straight away if
+// called from a task, otherwise on the next taskTick.
+void taskSignal(uint8_t events);
+
+// Counts down sleeping tasks and runs the ones that are due, once per tick
+void taskTick();
+
+// For the TASK_ macros only
+void taskSleep(Task *, uint16_t ticks);
+void taskWait(Task *, uint8_t events);
+
+#endif // TASK_H_
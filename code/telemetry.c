@@ -0,0 +1,44 @@
+#include "telemetry.h"
+
+volatile uint8_t telemetryBuffer[TELEMETRY_BUFFER_SIZE];
+volatile uint8_t telemetryHead;
+volatile uint8_t telemetryTail;
+volatile uint16_t telemetryTxShift;
+volatile uint8_t telemetryTxBits;
+
+// Frames that didn't fit the buffer, reported with the next overrun event
+static uint8_t _dropped;
+
+void telemetryInit() {
+  // Idle line level is high
+  PORTA |= _BV(TELEMETRY_PIN);
+}
+
+// Never blocks: if the whole frame doesn't fit in the buffer, it's dropped.
+void telemetrySend(uint8_t type, uint8_t a, uint8_t b, uint8_t c) {
+  uint8_t head = telemetryHead;
+  uint8_t used = (head - telemetryTail) & TELEMETRY_BUFFER_MASK;
+
+  // One byte always stays free, to tell a full buffer from an empty one
+  if (used + TELEMETRY_FRAME_SIZE > TELEMETRY_BUFFER_MASK) {
+    if (_dropped < 0xFF) _dropped++;
+    return;
+  }
+
+  if (type == TELEMETRY_EVT_OVERRUN) {
+    b = _dropped;
+    _dropped = 0;
+  }
+
+  uint8_t frame[TELEMETRY_FRAME_SIZE] = {
+    TELEMETRY_SYNC, type, a, b, c, TELEMETRY_CHECKSUM(type, a, b, c)
+  };
+
+  for (uint8_t i = 0; i < TELEMETRY_FRAME_SIZE; i++) {
+    telemetryBuffer[head] = frame[i];
+    head = (head + 1) & TELEMETRY_BUFFER_MASK;
+  }
+
+  // Publish the frame to the interrupt in one go
+  telemetryHead = head;
+}
@@ -0,0 +1,88 @@
+#ifndef TELEMETRY_H_
+#define TELEMETRY_H_
+
+#include "stdint.h"
+
+// Live event stream, sent over a transmit-only software UART on PA0 in builds
+// made with TELEMETRY=1. In other builds PA0 is the debug LED, and everything
+// here compiles to nothing.
+//
+// Every event is sent as a fixed size frame:
+//
+//   [TELEMETRY_SYNC] [type] [a] [b] [c] [checksum]
+//
+// where checksum is the bitwise inverse of the 8 bit sum of type, a, b and c.
+// The line format is 8N1 at TELEMETRY_BAUD (see timing.h), least significant
+// bit first. This part of the file is shared with host/telemetry-decode.c, so
+// keep it free of AVR specifics.
+
+#define TELEMETRY_SYNC       0xA5
+#define TELEMETRY_FRAME_SIZE 6
+
+// Event types, with the meaning of the a, b, c payload bytes
+#define TELEMETRY_EVT_BOOT     0x01 // a: MCUSR, b: 1 if game was restored
+#define TELEMETRY_EVT_POINT    0x02 // a: player, b: p1 score, c: p2 score
+#define TELEMETRY_EVT_UNDO     0x03 // a: player, b: p1 score, c: p2 score
+#define TELEMETRY_EVT_GAME_END 0x04 // a: winner, b: p1 set score, c: p2 set
+#define TELEMETRY_EVT_MODE     0x05 // a: display mode
+#define TELEMETRY_EVT_OVERRUN  0x06 // a: overruns (saturating), b: dropped,
+                                    // c: ticks behind
+#define TELEMETRY_EVT_SAVE     0x07 // a: p1 all time score, b: p2 all time
+#define TELEMETRY_EVT_STACK    0x08 // a, b: min free stack low, high, c: fault
+
+#define TELEMETRY_CHECKSUM(type, a, b, c) \
+  ((uint8_t)~(uint8_t)((type) + (a) + (b) + (c)))
+
+#ifdef TELEMETRY
+
+#include <avr/io.h>
+
+#define TELEMETRY_PIN PORTA0
+
+// Ring buffer size in bytes, has to be a power of 2
+#define TELEMETRY_BUFFER_SIZE 32
+#define TELEMETRY_BUFFER_MASK (TELEMETRY_BUFFER_SIZE - 1)
+
+// Shared with the Timer0 interrupt. Only telemetrySend moves the head, only
+// telemetryShiftBit moves the tail, so single byte accesses are enough.
+extern volatile uint8_t telemetryBuffer[TELEMETRY_BUFFER_SIZE];
+extern volatile uint8_t telemetryHead;
+extern volatile uint8_t telemetryTail;
+extern volatile uint16_t telemetryTxShift;
+extern volatile uint8_t telemetryTxBits;
+
+void telemetryInit();
+void telemetrySend(uint8_t type, uint8_t a, uint8_t b, uint8_t c);
+
+// Puts the next bit on the line, to be called from the Timer0 interrupt at
+// TELEMETRY_BAUD. Inline so the interrupt doesn't have to save every register
+// for a function call.
+static inline void telemetryShiftBit() {
+  if (telemetryTxBits == 0) {
+    // Line idles high
+    if (telemetryHead == telemetryTail) return;
+
+    // Start bit (0), 8 data bits, stop bit (1), shifted out from bit 0 up
+    telemetryTxShift = ((uint16_t)telemetryBuffer[telemetryTail] << 1) | 0x200;
+    telemetryTail = (telemetryTail + 1) & TELEMETRY_BUFFER_MASK;
+    telemetryTxBits = 10;
+  }
+
+  if (telemetryTxShift & 0x01) {
+    PORTA |= _BV(TELEMETRY_PIN);
+  } else {
+    PORTA &= ~_BV(TELEMETRY_PIN);
+  }
+
+  telemetryTxShift >>= 1;
+  telemetryTxBits--;
+}
+
+#else
+
+static inline void telemetryInit() {}
+static inline void telemetrySend(uint8_t type, uint8_t a, uint8_t b, uint8_t c) {}
+
+#endif // TELEMETRY
+
+#endif // TELEMETRY_H_
@@ -0,0 +1,280 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+// Timer configuration, derived from F_CPU at compile time.
+//
+// F_CPU comes from CLOCK in the Makefile. Everything timing related that used
+// to be worked out by hand for 16MHz is calculated here instead, so the same
+// source runs correctly on a board with an 8MHz internal oscillator, or any
+// other clock, as long as it can be represented. If it can't be, within 1%, the
+// build fails rather than silently running at the wrong speed.
+
+#include "stdint.h"
+
+#ifndef F_CPU
+#error "F_CPU must be defined, it is set from CLOCK in the Makefile"
+#endif
+
+// Allowed error, in percent, for the tick period and note frequencies
+#define TIMING_MAX_ERROR_PCT 1
+
+#define TIMING_ABS_DIFF(a, b) ((a) > (b) ? (a) - (b) : (b) - (a))
+#define TIMING_WITHIN_ERROR(actual, ideal) \
+  (TIMING_ABS_DIFF(actual, ideal) * 100 <= (ideal) * TIMING_MAX_ERROR_PCT)
+
+//------------------------------------------------------------------------------
+// Tick - Timer / Counter 0
+//------------------------------------------------------------------------------
+
+#define TICK_MS 2
+#define TIMING_TICKS_PER_SECOND (1000 / TICK_MS)
+
+// Converts a duration in milliseconds to a (rounded down) number of ticks
+#define TIMING_MS_TO_TICKS(ms) ((ms) / TICK_MS)
+
+// CPU cycles in one tick. No casts in here or below, these are used in #if
+#define TIMING_T0_CYCLES_PER_TICK (F_CPU * TICK_MS / 1000)
+
+#ifdef TELEMETRY
+  // In the telemetry build Timer0 interrupts once per bit of the software
+  // UART, and the tick is derived from that, see TIMING_T0_COUNTS_PER_TICK.
+  #define TELEMETRY_BAUD 9600
+  #define TIMING_T0_CYCLES_PER_INTERRUPT (F_CPU / TELEMETRY_BAUD)
+#else
+  #define TIMING_T0_CYCLES_PER_INTERRUPT TIMING_T0_CYCLES_PER_TICK
+#endif
+
+// Pick the smallest prescaler that lets the 8 bit counter span a whole
+// interrupt period, that gives us the best resolution. TIMING_T0_CS are the
+// matching CS02:00 clock select bits for TCCR0B.
+#if TIMING_T0_CYCLES_PER_INTERRUPT <= 256
+  #define TIMING_T0_PRESCALER 1
+  #define TIMING_T0_CS        0x01
+#elif TIMING_T0_CYCLES_PER_INTERRUPT <= 256 * 8
+  #define TIMING_T0_PRESCALER 8
+  #define TIMING_T0_CS        0x02
+#elif TIMING_T0_CYCLES_PER_INTERRUPT <= 256 * 64
+  #define TIMING_T0_PRESCALER 64
+  #define TIMING_T0_CS        0x03
+#elif TIMING_T0_CYCLES_PER_INTERRUPT <= 256 * 256
+  #define TIMING_T0_PRESCALER 256
+  #define TIMING_T0_CS        0x04
+#elif TIMING_T0_CYCLES_PER_INTERRUPT <= 256 * 1024
+  #define TIMING_T0_PRESCALER 1024
+  #define TIMING_T0_CS        0x05
+#else
+  #error "TICK_MS is too long for Timer0 at this F_CPU, check CLOCK"
+#endif
+
+// In CTC mode the counter runs from 0 up to and including OCR0A
+#define TIMING_T0_OCR \
+  ((TIMING_T0_CYCLES_PER_INTERRUPT + TIMING_T0_PRESCALER / 2) \
+   / TIMING_T0_PRESCALER - 1)
+
+#ifdef TELEMETRY
+  // Timer0 counts in a tick. The interrupt adds TIMING_T0_OCR + 1 counts to an
+  // accumulator each time, and signals a tick whenever it passes this. That
+  // keeps the average tick exact, with up to one bit period of jitter.
+  #define TIMING_T0_COUNTS_PER_TICK \
+    (TIMING_T0_CYCLES_PER_TICK / TIMING_T0_PRESCALER)
+
+  _Static_assert(
+      TIMING_T0_CYCLES_PER_TICK % TIMING_T0_PRESCALER == 0,
+      "TICK_MS isn't a whole number of Timer0 counts at this F_CPU");
+
+  _Static_assert(
+      TIMING_WITHIN_ERROR(
+        (TIMING_T0_OCR + 1) * TIMING_T0_PRESCALER,
+        TIMING_T0_CYCLES_PER_INTERRUPT),
+      "TELEMETRY_BAUD can't be represented within 1% at this F_CPU");
+#else
+  _Static_assert(
+      TIMING_WITHIN_ERROR(
+        (TIMING_T0_OCR + 1) * TIMING_T0_PRESCALER,
+        TIMING_T0_CYCLES_PER_TICK),
+      "TICK_MS can't be represented within 1% by Timer0 at this F_CPU");
+#endif
+
+// Converts a number of Timer0 counts to microseconds, for measuring how long
+// things take. Rounded down, and 32 bits wide: at large prescalers a count
+// is a lot of microseconds.
+#define TIMING_T0_COUNTS_TO_US(counts) \
+  ((uint32_t)(counts) * TIMING_T0_PRESCALER / (F_CPU / 1000000UL))
+
+//------------------------------------------------------------------------------
+// Idle clock - CLKPR
+//------------------------------------------------------------------------------
+
+// While nothing is going on, main.c divides the system clock by
+// TIMING_IDLE_DIV, and gives Timer0 a prescaler that many times smaller,
+// TIMING_T0_IDLE_CS. Timer0 then still counts at the same rate, so OCR0A, the
+// tick and the conversions above hold at either clock. TIMING_IDLE_CLKPS are
+// the matching CLKPS3:0 bits. Not in the telemetry build, its UART needs the
+// full clock, nor when Timer0 already runs unprescaled.
+#if defined(TELEMETRY) || TIMING_T0_PRESCALER == 1
+  #define TIMING_IDLE_DIV 1
+#elif TIMING_T0_PRESCALER == 8
+  #define TIMING_IDLE_DIV    8
+  #define TIMING_IDLE_CLKPS  3
+  #define TIMING_T0_IDLE_CS  0x01
+#elif TIMING_T0_PRESCALER == 64
+  #define TIMING_IDLE_DIV    8
+  #define TIMING_IDLE_CLKPS  3
+  #define TIMING_T0_IDLE_CS  0x02
+#elif TIMING_T0_PRESCALER == 256
+  #define TIMING_IDLE_DIV    4
+  #define TIMING_IDLE_CLKPS  2
+  #define TIMING_T0_IDLE_CS  0x03
+#else
+  #define TIMING_IDLE_DIV    4
+  #define TIMING_IDLE_CLKPS  2
+  #define TIMING_T0_IDLE_CS  0x04
+#endif
+
+//------------------------------------------------------------------------------
+// Notes - Timer / Counter 1
+//------------------------------------------------------------------------------
+
+// Note frequencies in octave TIMING_BASE_OCTAVE, in centihertz.
+// X(note, centihertz), note as in tonegenNotes.
+#define TIMING_NOTES(X) \
+  X(C,  26163) \
+  X(Db, 27718) \
+  X(D,  29366) \
+  X(Eb, 31113) \
+  X(E,  32963) \
+  X(F,  34923) \
+  X(Gb, 36999) \
+  X(G,  39200) \
+  X(Ab, 41530) \
+  X(A,  44000) \
+  X(Bb, 46616) \
+  X(B,  49388)
+
+#define TIMING_BASE_OCTAVE 4
+// Range of octaves melodies can use; checked against F_CPU below
+#define TIMING_MIN_OCTAVE  3
+#define TIMING_MAX_OCTAVE  7
+
+// The lowest note we can play, C in the lowest octave, decides the prescaler:
+// the output pin toggles on every compare match, so one half period has to fit
+// the 16 bit counter.
+#define TIMING_T1_LOWEST_HALF_PERIOD \
+  (F_CPU * 100 * (1 << (TIMING_BASE_OCTAVE - TIMING_MIN_OCTAVE)) / (2 * 26163))
+
+// TIMING_T1_CS are the CS12:10 clock select bits for TCCR1B
+#if TIMING_T1_LOWEST_HALF_PERIOD <= 65536
+  #define TIMING_T1_PRESCALER 1
+  #define TIMING_T1_CS        0x01
+#elif TIMING_T1_LOWEST_HALF_PERIOD <= 65536 * 8
+  #define TIMING_T1_PRESCALER 8
+  #define TIMING_T1_CS        0x02
+#elif TIMING_T1_LOWEST_HALF_PERIOD <= 65536 * 64
+  #define TIMING_T1_PRESCALER 64
+  #define TIMING_T1_CS        0x03
+#else
+  #error "F_CPU is too fast for Timer1 to play the lowest note, check CLOCK"
+#endif
+
+// Timer1 counts for half a period of a note in the base octave
+#define TIMING_T1_IDEAL_COUNTS(centihertz) \
+  ((unsigned long long)F_CPU * 100 / (2 * TIMING_T1_PRESCALER) / (centihertz))
+
+#define TIMING_NOTE_COUNTS(centihertz) \
+  ((uint16_t)(((unsigned long long)F_CPU * 100 / (2 * TIMING_T1_PRESCALER) \
+               + (centihertz) / 2) / (centihertz)))
+
+// Shifts base octave half period counts to another octave, rounding when going
+// up. The result goes into OCR1A after subtracting 1, since in CTC mode the
+// counter includes the compare value itself.
+#define TIMING_OCTAVE_COUNTS(counts, octave) \
+  ((octave) >= TIMING_BASE_OCTAVE \
+   ? ((counts) + ((1u << ((octave) - TIMING_BASE_OCTAVE)) >> 1)) \
+     >> ((octave) - TIMING_BASE_OCTAVE) \
+   : (counts) << (TIMING_BASE_OCTAVE - (octave)))
+
+// The top and bottom octave are the worst cases: the top for resolution, the
+// bottom for fitting 16 bits.
+#define TIMING_CHECK_NOTE(note, centihertz) \
+  _Static_assert( \
+      TIMING_WITHIN_ERROR( \
+        (unsigned long long)TIMING_OCTAVE_COUNTS( \
+          TIMING_NOTE_COUNTS(centihertz), TIMING_MAX_OCTAVE) \
+          << (TIMING_MAX_OCTAVE - TIMING_BASE_OCTAVE), \
+        TIMING_T1_IDEAL_COUNTS(centihertz)), \
+      "Note " #note " can't be played within 1% at this F_CPU"); \
+  _Static_assert( \
+      (unsigned long long)TIMING_NOTE_COUNTS(centihertz) \
+        << (TIMING_BASE_OCTAVE - TIMING_MIN_OCTAVE) <= 65536, \
+      "Note " #note " doesn't fit Timer1 in the lowest octave");
+
+TIMING_NOTES(TIMING_CHECK_NOTE)
+
+#ifdef TONEGEN_DDS
+
+//------------------------------------------------------------------------------
+// Notes - Direct digital synthesis on Timer1 fast PWM
+//------------------------------------------------------------------------------
+
+// Timer1 runs at F_CPU in fast PWM with TOP in ICR1, and every overflow is
+// one sample. TOP is picked to get close to this rate, above hearing range so
+// the PWM carrier isn't audible.
+#define TIMING_DDS_TARGET_RATE 31250
+
+// Cycles the sample interrupt may take, including its prologue and epilogue.
+// The sample rate is lowered if needed to keep the interrupt under a quarter
+// of the CPU, so the tick and the button interrupt are never starved.
+#define TIMING_DDS_CYCLE_BUDGET 128
+
+#if F_CPU / TIMING_DDS_TARGET_RATE >= 4 * TIMING_DDS_CYCLE_BUDGET
+  #define TIMING_DDS_PERIOD (F_CPU / TIMING_DDS_TARGET_RATE)
+#else
+  #define TIMING_DDS_PERIOD (4 * TIMING_DDS_CYCLE_BUDGET)
+#endif
+
+#define TIMING_DDS_PWM_TOP (TIMING_DDS_PERIOD - 1)
+
+_Static_assert(
+    TIMING_DDS_PWM_TOP >= 255,
+    "F_CPU is too slow for 8 bit DDS samples at TIMING_DDS_TARGET_RATE");
+
+_Static_assert(
+    TIMING_DDS_PWM_TOP <= 0xFFFF,
+    "F_CPU is too fast for Timer1 at TIMING_DDS_TARGET_RATE");
+
+// 16 bit phase accumulator increment per sample for a note in the base
+// octave: 65536 * frequency / sample rate.
+#define TIMING_DDS_IDEAL_INC_X100(centihertz) \
+  ((unsigned long long)(centihertz) * 65536 * TIMING_DDS_PERIOD / F_CPU)
+
+#define TIMING_DDS_INC(centihertz) \
+  ((uint16_t)(((unsigned long long)(centihertz) * 65536 * TIMING_DDS_PERIOD \
+               + 50ULL * F_CPU) / (100ULL * F_CPU)))
+
+// Going up an octave doubles the increment exactly; going down rounds
+#define TIMING_DDS_OCTAVE_INC(inc, octave) \
+  ((octave) >= TIMING_BASE_OCTAVE \
+   ? (inc) << ((octave) - TIMING_BASE_OCTAVE) \
+   : ((inc) + ((1u << (TIMING_BASE_OCTAVE - (octave))) >> 1)) \
+     >> (TIMING_BASE_OCTAVE - (octave)))
+
+// The lowest octave is the worst case for resolution, the top one has to stay
+// below half the sample rate.
+#define TIMING_CHECK_DDS_NOTE(note, centihertz) \
+  _Static_assert( \
+      TIMING_WITHIN_ERROR( \
+        (unsigned long long)TIMING_DDS_OCTAVE_INC( \
+          TIMING_DDS_INC(centihertz), TIMING_MIN_OCTAVE) \
+          * 100 << (TIMING_BASE_OCTAVE - TIMING_MIN_OCTAVE), \
+        TIMING_DDS_IDEAL_INC_X100(centihertz)), \
+      "Note " #note " can't be synthesized within 1% at this F_CPU"); \
+  _Static_assert( \
+      (unsigned long long)TIMING_DDS_INC(centihertz) \
+        << (TIMING_MAX_OCTAVE - TIMING_BASE_OCTAVE) < 0x8000, \
+      "Note " #note " is above half the sample rate in the highest octave");
+
+TIMING_NOTES(TIMING_CHECK_DDS_NOTE)
+
+#endif // TONEGEN_DDS
+
+#endif // TIMING_H_
@@ -1,163 +1,264 @@
 #include "tonegen.h"
-#include "animation.h"
+#include "task.h"
+#include "settings.h"
+#include "trace.h"
 #include <avr/io.h>
 #include "stddef.h"
-
-static uint16_t startupSeq[] = {
+#include "timing.h"
+#include <avr/pgmspace.h>
+#ifdef TONEGEN_DDS
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#endif
+
+static const uint16_t startupSeq[] PROGMEM = {
   0x0401, // C4, 1
   0x4401, // E4, 1
   0x7401, // G4, 1
   0x0502  // C5, 2
 };
 
-static uint16_t winSeq[] = {
+static const uint16_t winSeq[] PROGMEM = {
   0x7401, // G4, 1
   0x0501, // C5, 1
   0x4501, // E5, 1
   0x7501, // G5, 1
   0xC401, // R,  1
   0x4501, // E5, 1
+  0x0500, // C5, chord with:
   0x7504  // G5, 4
 };
 
-static uint16_t buttonPressSeq[] = {
+static const uint16_t buttonPressSeq[] PROGMEM = {
   0x0401, // C4, 1
   0x0501, // C5, 1
 };
 
-static uint16_t buttonLongPressSeq[] = {
+static const uint16_t buttonLongPressSeq[] PROGMEM = {
   0x0503, // G5, 3
   0x0402, // C4, 1
 };
 
+// What happens to a melody triggered while one of at least its priority is
+// playing. A higher priority one always cuts the one playing short.
+#define POLICY_DROP    0 // Not played
+#define POLICY_QUEUE   1 // Played after it, if there's room in the queue
+#define POLICY_OVERLAY 2 // Played over it, see below
+#define POLICY_DUCK    3 // Played over it, which goes on quieter under it.
+                         // Only with DDS, square waves can't mix, so overlay.
+
+// Melody definitions live in flash, only the playback state is in RAM
 typedef struct {
-  uint16_t * seqPtr;
-  uint16_t length;
-  // differs in that this is how many ticks it takes to complete
-  uint16_t duration; 
-  uint16_t stepTicks;
-  uint16_t position;
-  uint16_t stepPosition;
+  const uint16_t * seqPtr;
+  uint8_t length;
+  uint8_t stepTicks;
+  uint8_t priority;
+  uint8_t policy;
 } Melody;
 
-static uint8_t BASE_OCTAVE = 4; 
-static volatile Animation melodyAnim;
+#define MELODY(seq, stepMs, prio, pol) { \
+    .seqPtr = seq, \
+    .length = sizeof(seq) / sizeof(uint16_t), \
+    .stepTicks = TIMING_MS_TO_TICKS(stepMs), \
+    .priority = prio, \
+    .policy = pol, \
+  }
 
-static Melody startupMelody;
-static Melody winMelody;
-static Melody buttonPressMelody;
-static Melody buttonLongPressMelody;
+// Indexed by Melodies. A second table's win jingle waits for the first, and
+// button sounds go over whatever is playing instead of stopping it. A click
+// only ducks it, a long press, which changes modes, cuts through.
+static const Melody melodies[] PROGMEM = {
+  MELODY(startupSeq, 100, 1, POLICY_DROP),           // StartupMelo
+  MELODY(winSeq, 150, 2, POLICY_QUEUE),              // WinMelo
+  MELODY(buttonPressSeq, 50, 0, POLICY_DUCK),        // ButtonPressSfx
+  MELODY(buttonLongPressSeq, 50, 0, POLICY_OVERLAY), // ButtonLongPressSfx
+};
 
-static volatile Melody * activeMelody;
+#define MELODIES (sizeof(melodies) / sizeof(Melody))
+#define MELODY_NONE 0xFF
 
-// These are calculated based on:
-// - 16MHz clock frequency
-// - Timer prescaler of 8
-// - Toggling pin on match
+// Two players share Timer1. The main one plays melodies one after another,
+// the overlay one plays a melody over it: while it does, the main one keeps
+// time but stays silent, and once it's done, the main one picks up again with
+// the notes of the step it got to. Whichever is heard owns Timer1.
 //
-// Since the pin is toggled on every match, the frequency at which matches
-// occur equals half the period of the output square wave.
-// Thus: 16 000 000Hz / 8 / compare value = 2x the output frequency
-// For example, A4: 16 000 000Hz / 8 / 227.7272 = 880 Hz = 2x 440Hz
-static float compValues[] = {
-  3822.1916, //C4  - 261.63Hz
-  3607.7639, //Db4 - 277.18Hz
-  3405.2986, //D4  - 293.66Hz
-  3214.0906, //Eb4 - 311.13Hz
-  3033.7045, //E4  - 329.63Hz
-  2863.4424, //F4  - 349.23Hz
-  2702.7758, //Gb4 - 369.99Hz
-  2551.0204, //G4  - 392.00Hz
-  2407.8979, //Ab4 - 415.30Hz
-  2272.7272, //A4  - 440Hz
-  2145.1862, //Bb4 - 466.16Hz
-  2024.7833  //B4  - 493.88Hz
+// An overlay melody that ducks leaves the main one heard: it gets the first
+// DDS voice at a lower level, the overlay the second, and neither plays
+// chords until the overlay is done.
+typedef struct {
+  Task task;
+  Melody def; // Copy of the definition of the melody playing
+  uint8_t melody; // MELODY_NONE when idle
+  uint8_t step; // First note of the step playing, chord notes come first
+  uint8_t next; // First note of the step after
+} Player;
+
+#define PLAYER_MAIN    0
+#define PLAYER_OVERLAY 1
+
+static Player players[2] = {
+  { .melody = MELODY_NONE },
+  { .melody = MELODY_NONE },
+};
+
+// Melodies waiting for the main player, a ring. Has to be a power of 2.
+#define QUEUE_SIZE 2
+#define QUEUE_MASK (QUEUE_SIZE - 1)
+
+static uint8_t queue[QUEUE_SIZE];
+static uint8_t queueHead;
+static uint8_t queueLength;
+
+#ifdef TONEGEN_DDS
+
+#define DDS_VOICES 2
+
+// Wavetable size, a power of 2. The top bits of the phase accumulator index it.
+#define DDS_WAVE_SIZE   32
+#define DDS_PHASE_SHIFT 11
+
+// Envelope levels go from 0 (silent) to DDS_LEVEL_MAX. A note starts at the
+// peak, decays to the sustain level, and fades out on release. The level
+// changes by one step every DDS_ENVELOPE_TICKS.
+#define DDS_LEVEL_MAX      15
+#define DDS_LEVEL_SUSTAIN  9
+#define DDS_LEVEL_DUCKED   3 // The main player's, under a ducking overlay
+#define DDS_ENVELOPE_TICKS TIMING_MS_TO_TICKS(16)
+
+// The sample interrupt is straight line code, so its cost doesn't depend on
+// what is playing. It has to stay within TIMING_DDS_CYCLE_BUDGET, which the
+// sample rate is based on. Build with TONEGEN_DDS_MEASURE to have it record
+// the actual worst case, see tonegenMaxSampleCycles.
+
+// One period, 0-255. A sine with some 2nd and 3rd harmonic, which carries a
+// lot better on a piezo buzzer than a pure sine does.
+static const uint8_t wavetable[DDS_WAVE_SIZE] PROGMEM = {
+  128, 174, 214, 242, 255, 255, 244, 228,
+  213, 200, 191, 186, 181, 173, 162, 146,
+  128, 109,  93,  82,  74,  69,  64,  55,
+   42,  27,  11,   0,   0,  13,  41,  81,
+};
+
+typedef struct {
+  uint16_t phase;
+  uint16_t increment;
+  uint8_t level;
+  uint8_t targetLevel;
+  // The wavetable scaled to the current level. Done here whenever the level
+  // changes, since there is no hardware multiply for the interrupt to use.
+  uint8_t wave[DDS_WAVE_SIZE];
+} DdsVoice;
+
+static volatile DdsVoice voices[DDS_VOICES];
+static uint8_t envelopeTicks;
+
+#ifdef TONEGEN_DDS_MEASURE
+static volatile uint16_t maxSampleCycles;
+#endif
+
+// Phase accumulator increments per sample for each note in TIMING_BASE_OCTAVE,
+// derived from F_CPU and the sample rate in timing.h.
+#define NOTE_INCREMENT(note, centihertz) TIMING_DDS_INC(centihertz),
+static const uint16_t noteIncrements[] PROGMEM = {
+  TIMING_NOTES(NOTE_INCREMENT)
+};
+
+static void setVoiceLevel(uint8_t voice, uint8_t level);
+static void duck();
+
+#else
+
+// Timer1 counts for half a period of each note in TIMING_BASE_OCTAVE.
+// Since the pin is toggled on every compare match, matches have to occur at
+// twice the frequency of the note. These are derived from F_CPU and the
+// prescaler picked in timing.h, which also checks they're accurate enough.
+#define NOTE_COUNTS(note, centihertz) TIMING_NOTE_COUNTS(centihertz),
+static const uint16_t noteCounts[] PROGMEM = {
+  TIMING_NOTES(NOTE_COUNTS)
 };
 
+#endif // TONEGEN_DDS
+
 static uint16_t getCompValue(uint8_t noteIndex, uint8_t octave);
-static void calcMelodyDuration(Melody * );
+static uint16_t readStep(Player * player, uint8_t index);
 static void decodeStep(
     uint16_t raw,
     uint8_t * outNnote, uint8_t * outOctave, uint8_t * outDuration);
-static void playNote(tonegenNotes note, uint8_t octave);
-static void melodyFrame(Animation *);
+static void startMelody(Player * player, uint8_t melody);
+static bool dequeue(Player * player);
+static void stopped(Player * player);
+static uint8_t playStep(Player * player);
+static void playNote(uint8_t voice, tonegenNotes note, uint8_t octave);
+static bool ducking();
+static void playMelody(Task *);
 
 void tonegenInit() {
-  startupMelody.seqPtr = startupSeq;
-  startupMelody.length = sizeof(startupSeq) / sizeof(uint16_t);
-  startupMelody.stepTicks = 50;
-  calcMelodyDuration(&startupMelody);
-
-  buttonPressMelody.seqPtr = buttonPressSeq;
-  buttonPressMelody.length = sizeof(buttonPressSeq) / sizeof(uint16_t);
-  buttonPressMelody.stepTicks = 25;
-  calcMelodyDuration(&buttonPressMelody);
+  // Nothing to set up at runtime, melodies are played by tasks
+}
 
-  buttonLongPressMelody.seqPtr = buttonLongPressSeq;
-  buttonLongPressMelody.length = sizeof(buttonLongPressSeq) / sizeof(uint16_t);
-  buttonLongPressMelody.stepTicks = 25;
-  calcMelodyDuration(&buttonLongPressMelody);
+// Decided on what is playing right now, nothing is searched or sorted
+void tonegenTriggerMelody(Melodies melodyName) {
+  Player * mainPlayer = &players[PLAYER_MAIN];
+  uint8_t priority;
 
-  winMelody.seqPtr = winSeq;
-  winMelody.length = sizeof(winSeq) / sizeof(uint16_t);
-  winMelody.stepTicks = 75;
-  calcMelodyDuration(&winMelody);
+  TRACE(TRACE_EVT_MELODY, melodyName);
 
-  melodyAnim.frame = (animatorFunction)melodyFrame;
-}
+  if (!settings.sound) return;
+  if (melodyName >= MELODIES) return;
 
-void tonegenTriggerMelody(Melodies melodyName) {
-  Melody * melo;
+  priority = pgm_read_byte(&melodies[melodyName].priority);
 
-  if (melodyName == ButtonPressSfx && activeMelody != NULL 
-      && activeMelody != &buttonPressMelody
-      && activeMelody != &buttonLongPressMelody) {
-    // If we have a melody playing, don't interrupt it with the button press
-    // sound effect
+  if (mainPlayer->melody == MELODY_NONE
+      || priority > mainPlayer->def.priority) {
+    startMelody(mainPlayer, melodyName);
     return;
   }
 
-  TONEGEN_OFF();
-  animationSetActiveMelody(NULL);
-
-  switch (melodyName) {
-    case StartupMelo: melo = &startupMelody; break;
-    case WinMelo: melo = &winMelody; break;
-    case ButtonPressSfx: melo = &buttonPressMelody; break;
-    case ButtonLongPressSfx: melo = &buttonLongPressMelody; break;
-    default: return;
+  switch (pgm_read_byte(&melodies[melodyName].policy)) {
+    case POLICY_QUEUE:
+      if (queueLength < QUEUE_SIZE) {
+        queue[(queueHead + queueLength) & QUEUE_MASK] = melodyName;
+        queueLength++;
+      }
+      break;
+
+    case POLICY_DUCK:
+    case POLICY_OVERLAY:
+      startMelody(&players[PLAYER_OVERLAY], melodyName);
+      break;
+
+    default:
+      break;
   }
-
-  melo->position = 0;
-  melo->stepPosition = 0;
-  activeMelody = melo;
-
-  melodyAnim.stepTicks = melo->stepTicks;
-  melodyAnim.position = 0;
-  melodyAnim.duration = melo->duration;
-  animationSetActiveMelody(&melodyAnim);
 }
 
-void tonegenClear() {
-  activeMelody = NULL;
+bool tonegenIsSilent() {
+  return players[PLAYER_MAIN].melody == MELODY_NONE
+    && players[PLAYER_OVERLAY].melody == MELODY_NONE
+#ifdef TONEGEN_DDS
+    && !(TIMSK1 & _BV(TOIE1));
+#else
+    && !(TCCR1A & 0x40);
+#endif
 }
 
+// Timer1 value for a note: compare value for the square wave, or phase
+// increment per sample for DDS.
 static uint16_t getCompValue(uint8_t noteIndex, uint8_t octave) {
-  float multiplier = 1;
-  int8_t octaveOffset = BASE_OCTAVE - octave;
-  bool down = octaveOffset < 0;
-
-  while (octaveOffset != 0) {
-    multiplier *= down ? 0.5 : 2;
-    octaveOffset += down ? 1 : -1;
-  }
-
   if (noteIndex > 11) noteIndex = noteIndex % 12;
+  if (octave < TIMING_MIN_OCTAVE) octave = TIMING_MIN_OCTAVE;
+  if (octave > TIMING_MAX_OCTAVE) octave = TIMING_MAX_OCTAVE;
+
+#ifdef TONEGEN_DDS
+  uint16_t increment = pgm_read_word(&noteIncrements[noteIndex]);
 
-  float compValue = compValues[noteIndex] * multiplier;
+  return (uint16_t)TIMING_DDS_OCTAVE_INC(increment, octave);
+#else
+  uint16_t counts = pgm_read_word(&noteCounts[noteIndex]);
 
-  // Poor man's round()
-  return (uint16_t)(compValue + 0.5);
+  // In CTC mode the counter includes the compare value, hence the - 1
+  return (uint16_t)(TIMING_OCTAVE_COUNTS(counts, octave) - 1);
+#endif
 }
 
 static void decodeStep(
@@ -168,51 +269,237 @@ static void decodeStep(
   *outDuration = (uint8_t)(raw & 0x00FF);
 }
 
-static void calcMelodyDuration(Melody * melo) {
-  uint16_t i;
-  uint16_t ticksNeeded = 0;
+static uint16_t readStep(Player * player, uint8_t index) {
+  return pgm_read_word(&player->def.seqPtr[index]);
+}
+
+// From the top, on the next tick. The one playing on that player, if any, is
+// cut short.
+static void startMelody(Player * player, uint8_t melody) {
+  memcpy_P(&player->def, &melodies[melody], sizeof(Melody));
+  player->melody = melody;
+  taskStart(&player->task, playMelody);
+}
+
+// Moves the next queued melody onto the player, if there is one
+static bool dequeue(Player * player) {
+  if (queueLength == 0) return false;
+
+  player->melody = queue[queueHead];
+  memcpy_P(&player->def, &melodies[player->melody], sizeof(Melody));
+  queueHead = (queueHead + 1) & QUEUE_MASK;
+  queueLength--;
+
+  return true;
+}
+
+// Hands Timer1 back to the main player when an overlay is done, or turns it
+// off if there's nothing left to hear
+static void stopped(Player * player) {
+  Player * mainPlayer = &players[PLAYER_MAIN];
+
+  player->melody = MELODY_NONE;
 
-  for (i = 0; i < melo->length; i++) {
-    ticksNeeded += melo->seqPtr[i] & 0x00FF;
+  if (player != mainPlayer && mainPlayer->melody != MELODY_NONE) {
+    playStep(mainPlayer);
+  } else if (players[PLAYER_OVERLAY].melody == MELODY_NONE) {
+    TONEGEN_OFF();
   }
+}
+
+// One step after another, each held for its duration. The main player then
+// goes on with the queue.
+static void playMelody(Task * task) {
+  Player * player = TASK_OWNER(task, Player, task);
+
+  TASK_BEGIN(task);
+
+  do {
+    for (player->step = 0;
+        player->step < player->def.length;
+        player->step = player->next) {
+      TASK_WAIT_TICKS(task, (uint16_t)playStep(player) * player->def.stepTicks);
+    }
+  } while (player == &players[PLAYER_MAIN] && dequeue(player));
 
-  melo->duration = ticksNeeded + 1;
+  stopped(player);
+
+  TASK_END(task);
 }
 
-static void melodyFrame(Animation * anim) {
+// Starts playing the player's current step, if the player is being heard.
+// Chord notes before it (duration 0) go to the second voice. Returns the
+// step's duration.
+static uint8_t playStep(Player * player) {
+  uint8_t index = player->step;
   uint8_t sNote;
   uint8_t sOctave;
   uint8_t sDuration;
-
-  decodeStep(activeMelody->seqPtr[activeMelody->position],
+  bool overlay = player == &players[PLAYER_OVERLAY];
+  bool ducked = ducking();
+  bool heard = overlay || ducked
+    || players[PLAYER_OVERLAY].melody == MELODY_NONE;
+  uint8_t voice = overlay && ducked ? 1 : 0;
+  bool chord = false;
+
+  decodeStep(readStep(player, index),
             &sNote, &sOctave, &sDuration);
 
-  if (activeMelody->stepPosition < sDuration) {
-    if (activeMelody->stepPosition == 0) {
-      playNote(sNote, sOctave);
-    }
+  while (sDuration == 0
+      && index + 1 < player->def.length) {
+#ifdef TONEGEN_DDS
+    if (heard && !ducked) playNote(1, sNote, sOctave);
+    chord = true;
+#endif
+    index++;
+    decodeStep(readStep(player, index),
+              &sNote, &sOctave, &sDuration);
+  }
 
-    activeMelody->stepPosition++;
-    return;
+  player->next = index + 1;
+
+  if (!heard) return sDuration;
+
+#ifdef TONEGEN_DDS
+  if (ducked) {
+    if (overlay) duck();
+  } else if (!chord) {
+    setVoiceLevel(1, 0);
   }
+#else
+  (void)chord;
+#endif
 
-  activeMelody->stepPosition = 0;
-  activeMelody->position++;
+  playNote(voice, sNote, sOctave);
 
-  if (activeMelody->position == activeMelody->length) {
-    TONEGEN_OFF();
-    activeMelody = NULL;
+  return sDuration;
+}
+
+#ifdef TONEGEN_DDS
+
+static void playNote(uint8_t voice, tonegenNotes note, uint8_t octave) {
+  if (note == Rest) {
+    voices[voice].targetLevel = 0;
     return;
   }
 
-  decodeStep(activeMelody->seqPtr[activeMelody->position],
-            &sNote, &sOctave, &sDuration);
+  uint16_t increment = getCompValue((uint8_t)note, octave);
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    voices[voice].increment = increment;
+  }
+
+  // Under a ducking overlay, the main player's notes hold the ducked level
+  if (voice == 0 && ducking()) {
+    voices[voice].targetLevel = DDS_LEVEL_DUCKED;
+    setVoiceLevel(voice, DDS_LEVEL_DUCKED);
+  } else {
+    voices[voice].targetLevel = DDS_LEVEL_SUSTAIN;
+    setVoiceLevel(voice, DDS_LEVEL_MAX);
+  }
+  envelopeTicks = 0;
+
+  // Connect OC1A (non-inverting fast PWM) and start the sample interrupt
+  TCCR1A |= _BV(COM1A1);
+  TIMSK1 |= _BV(TOIE1);
+}
+
+// Whether an overlay is playing that leaves the main player heard under it
+static bool ducking() {
+  Player * overlay = &players[PLAYER_OVERLAY];
+
+  return overlay->melody != MELODY_NONE && overlay->def.policy == POLICY_DUCK;
+}
+
+// Brings the main player's note down at once, it'd take the envelope too long
+static void duck() {
+  if (voices[0].targetLevel > DDS_LEVEL_DUCKED) {
+    voices[0].targetLevel = DDS_LEVEL_DUCKED;
+  }
+  if (voices[0].level > DDS_LEVEL_DUCKED) setVoiceLevel(0, DDS_LEVEL_DUCKED);
+}
+
+// Moves envelopes along, and stops the sample interrupt once all is quiet.
+void tonegenTick() {
+  bool silent = true;
+
+  if (!(TIMSK1 & _BV(TOIE1))) return;
+
+  if (++envelopeTicks < DDS_ENVELOPE_TICKS) return;
+  envelopeTicks = 0;
+
+  for (uint8_t i = 0; i < DDS_VOICES; i++) {
+    uint8_t level = voices[i].level;
+
+    if (level > voices[i].targetLevel) setVoiceLevel(i, level - 1);
+    if (voices[i].level > 0) silent = false;
+  }
+
+  if (silent) {
+    TIMSK1 &= ~_BV(TOIE1);
+    TCCR1A &= ~_BV(COM1A1);
+  }
+}
+
+// Lets all voices fade out
+void tonegenRelease() {
+  for (uint8_t i = 0; i < DDS_VOICES; i++) voices[i].targetLevel = 0;
+}
+
+#ifdef TONEGEN_DDS_MEASURE
+// Worst case cycles from the start of a PWM period to the end of the sample
+// interrupt, so interrupt latency included. Compare to TIMING_DDS_CYCLE_BUDGET.
+uint16_t tonegenMaxSampleCycles() {
+  uint16_t cycles;
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    cycles = maxSampleCycles;
+  }
+
+  return cycles;
+}
+#else
+uint16_t tonegenMaxSampleCycles() {
+  return 0;
+}
+#endif
+
+static void setVoiceLevel(uint8_t voice, uint8_t level) {
+  // Two voices at full level add up to at most 238, fits 8 bit samples
+  for (uint8_t i = 0; i < DDS_WAVE_SIZE; i++) {
+    voices[voice].wave[i] =
+      (uint8_t)(((uint16_t)pgm_read_byte(&wavetable[i]) * level) >> 5);
+  }
+
+  voices[voice].level = level;
+}
+
+// One sample per PWM period. Straight line code, so it always costs the same.
+ISR(TIM1_OVF_vect) {
+  uint8_t sample;
+
+  voices[0].phase += voices[0].increment;
+  sample = voices[0].wave[voices[0].phase >> DDS_PHASE_SHIFT];
+
+  voices[1].phase += voices[1].increment;
+  sample += voices[1].wave[voices[1].phase >> DDS_PHASE_SHIFT];
+
+  OCR1A = sample;
+
+#ifdef TONEGEN_DDS_MEASURE
+  // Timer1 counts CPU cycles from the start of the period
+  uint16_t cycles = TCNT1;
+  if (cycles > maxSampleCycles) maxSampleCycles = cycles;
+#endif
+}
+
+#else
 
-  playNote(sNote, sOctave);
-  activeMelody->stepPosition++;
+static bool ducking() {
+  return false;
 }
 
-void playNote(tonegenNotes note, uint8_t octave) {
+static void playNote(uint8_t voice, tonegenNotes note, uint8_t octave) {
   if (note == Rest) {
     TONEGEN_OFF();
     return;
@@ -222,3 +509,4 @@ void playNote(tonegenNotes note, uint8_t octave) {
   OCR1A = getCompValue((uint8_t)note, octave);
 }
 
+#endif // TONEGEN_DDS
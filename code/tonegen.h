@@ -4,8 +4,17 @@
 #include "stdbool.h"
 #include "stdint.h"
 
+#ifdef TONEGEN_DDS
+// Direct digital synthesis: Timer1 runs fast PWM on OC1A, and its overflow
+// interrupt mixes two voices from a wavetable. Stopping releases the voices,
+// the output is disconnected once their envelopes have faded out.
+#define TONEGEN_ON()
+#define TONEGEN_OFF() tonegenRelease();
+#else
+// Square wave: OC1A toggles on every compare match while connected
 #define TONEGEN_ON() TCCR1A |= 0x40;
 #define TONEGEN_OFF() TCCR1A &= ~(0x40);
+#endif
 
 // These enums are provided for convenience and code readability.
 // However, to conserve space, melodies will be written as sequences of
@@ -17,6 +26,10 @@
 //            held for
 // Digit 2:   This nibble says what octave the note is to be played at
 // Digit 3:   This nibble says which note is to be played, from toneGenNotes.
+//
+// A step with a duration of 0 is a chord note: it sounds together with the
+// step after it. Only the DDS build has a second voice to play it on, the
+// square wave build skips chord notes.
 
 typedef enum { C, Db, D, Eb, E, F, Gb, G, Ab, A, Bb, B, Rest } tonegenNotes;
 
@@ -31,6 +44,15 @@ void tonegenInit();
 
 void tonegenTriggerMelody(Melodies);
 
-void tonegenClear();
+// Nothing playing, and the output is off
+bool tonegenIsSilent();
+
+#ifdef TONEGEN_DDS
+void tonegenTick();
+void tonegenRelease();
+uint16_t tonegenMaxSampleCycles();
+#else
+static inline void tonegenTick() {}
+#endif
 
 #endif // TONEGEN_H_
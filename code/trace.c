@@ -0,0 +1,71 @@
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "trace.h"
+#include "display.h"
+
+#define TRACE_MAGIC 0x7ACE
+
+// None of this is initialised by the C runtime, so it survives a reset that
+// keeps power. _magic tells whether it's been set up since power-on.
+uint16_t traceRing[TRACE_EVENTS] __attribute__((section(".noinit")));
+uint8_t traceHead __attribute__((section(".noinit")));
+bool traceFrozen __attribute__((section(".noinit")));
+static uint16_t _magic __attribute__((section(".noinit")));
+
+static uint8_t _pageDigit;
+static uint8_t _pageIndex; // How many events back from the newest
+
+static const char _hex[] PROGMEM = "0123456789AbCdEF";
+
+static void _showEvent();
+
+void traceInit(uint8_t resetCause) {
+  if ((resetCause & _BV(PORF)) || _magic != TRACE_MAGIC) {
+    for (uint8_t i = 0; i < TRACE_EVENTS; i++) traceRing[i] = 0;
+    traceHead = 0;
+    traceFrozen = false;
+    _magic = TRACE_MAGIC;
+  } else {
+    // Whatever happened, don't let it write outside the ring
+    traceHead &= TRACE_MASK;
+    if ((resetCause & _BV(WDRF)) || resetCause == 0) traceFreeze();
+  }
+
+  // Not recorded if frozen, the boot isn't what we're after then
+  TRACE(TRACE_EVT_BOOT, resetCause);
+}
+
+void traceFreeze() {
+  traceFrozen = true;
+}
+
+// Frozen while reading, or the events would move along under the page
+void tracePageOpen(uint8_t firstDigit) {
+  traceFreeze();
+  _pageDigit = firstDigit;
+  _pageIndex = 0;
+  displaySetRow(_pageDigit + 4, 0);
+  displaySetRow(_pageDigit + 5, 0);
+  _showEvent();
+}
+
+void tracePageNext() {
+  _pageIndex = (_pageIndex + 1) & TRACE_MASK;
+  _showEvent();
+}
+
+void tracePageClose() {
+  traceFrozen = false;
+}
+
+static void _showEvent() {
+  uint16_t event = traceRing[(traceHead - 1 - _pageIndex) & TRACE_MASK];
+
+  for (uint8_t i = 0; i < 4; i++) {
+    displayWriteChar(
+        _pageDigit + i,
+        pgm_read_byte(&_hex[event & 0x0F]),
+        i == 0 && _pageIndex == 0);
+    event >>= 4;
+  }
+}
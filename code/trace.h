@@ -0,0 +1,86 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include "stdint.h"
+#include "stdbool.h"
+
+// Flight recorder, in builds made with TRACE=1. In other builds everything
+// here compiles to nothing, TRACE's arguments aren't even evaluated.
+//
+// TRACE appends a two byte event, a code and an argument, to a ring buffer in
+// .noinit. A reset that keeps power leaves the ring alone, so after a
+// watchdog reset, a crash (a jump to the reset vector, no MCUSR flags) or a
+// stack fault, it holds the last TRACE_EVENTS events before the failure. It is
+// frozen then, and stays that way until read on the trace page: hold player 2
+// and long press mode, as for the diagnostics page. Newest event first, mode
+// steps back in time, shown as four hex digits: code, then argument. The
+// newest event has the decimal point on.
+
+// Event codes, with their argument
+#define TRACE_EVT_BOOT       0x01 // MCUSR
+#define TRACE_EVT_BUTTON     0x02 // Pin << 1, 1 if pressed (pin low)
+#define TRACE_EVT_DISPATCH   0x03 // State after << 4, action
+#define TRACE_EVT_ANIM_START 0x04 // Animation
+#define TRACE_EVT_ANIM_STOP  0x05 // Animation
+#define TRACE_EVT_MELODY     0x06 // Melody
+#define TRACE_EVT_OVERRUN    0x07 // Ticks behind
+#define TRACE_EVT_STACK      0x08 // Free stack, saturated at 0xFF
+
+#ifdef TRACING
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// Has to be a power of 2. Two bytes each, so keep an eye on stackmon when
+// raising it.
+#ifndef TRACE_EVENTS
+#define TRACE_EVENTS 64
+#endif
+
+#define TRACE_MASK (TRACE_EVENTS - 1)
+
+_Static_assert(
+    (TRACE_EVENTS & TRACE_MASK) == 0 && TRACE_EVENTS <= 128,
+    "TRACE_EVENTS has to be a power of 2, up to 128");
+
+extern uint16_t traceRing[TRACE_EVENTS];
+extern uint8_t traceHead; // Where the next event goes
+extern bool traceFrozen;
+
+// Recorded from interrupts as well as the main loop, so interrupts are off
+// while the head moves. About 20 cycles whether frozen or not.
+#define TRACE(event, arg) traceRecord((event), (arg))
+
+static inline void traceRecord(uint8_t event, uint8_t arg) {
+  uint8_t sreg = SREG;
+
+  cli();
+  if (!traceFrozen) {
+    traceRing[traceHead] = ((uint16_t)event << 8) | arg;
+    traceHead = (traceHead + 1) & TRACE_MASK;
+  }
+  SREG = sreg;
+}
+
+// Starts over after power-on, freezes after a failure, see above. resetCause
+// is MCUSR as it was at reset.
+void traceInit(uint8_t resetCause);
+// Keeps what's there for the trace page, from now on
+void traceFreeze();
+
+// The trace page, on four digits starting at firstDigit. The recorder is
+// frozen while it's open, closing it lets the recorder run again.
+void tracePageOpen(uint8_t firstDigit);
+void tracePageNext();
+void tracePageClose();
+
+#else
+
+#define TRACE(event, arg) do {} while (0)
+
+static inline void traceInit(uint8_t resetCause) {}
+static inline void traceFreeze() {}
+
+#endif // TRACING
+
+#endif // TRACE_H_